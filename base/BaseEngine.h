@@ -13,7 +13,12 @@
 
 #include <VulkanContext.h>
 
-#include "util/Semaphore.h"
+#include "pipeline/PipelineCompiler.h"
+#include "shader/ShaderCache.h"
+#include "util/DeletionQueue.h"
+#include "descriptor/DescriptorAllocator.h"
+#include "memory/MemoryAllocator.h"
+#include "UniformRing.h"
 
 namespace vku {
 	struct BaseEngine {
@@ -32,7 +37,14 @@ namespace vku {
 		bool fullscreen = false;
 		double framerateLimit = 120.0;
 		uint32_t width = 800, height = 600;
+#ifdef VKMERC_NO_SHADERC
+		bool shaderHotReloadEnabled = false;
+#else
 		bool shaderHotReloadEnabled = true;
+#endif
+		// compile shaders in vkmerc-shaderbake worker processes, for crash isolation. empty compiles in-process.
+		std::string shaderCompilerWorkerPath = "";
+		uint32_t shaderCompilerWorkerCount = 2;
 
 	private:
 		// this flag will be tripped on the window-resize event
@@ -59,6 +71,10 @@ namespace vku {
 			info.resizeCallback = resizeCallbackFunc;
 
 			context = new VulkanContext(info);
+
+			if (!shaderCompilerWorkerPath.empty()) {
+				context->device->shaderCache->useCompilerWorkers(shaderCompilerWorkerPath, shaderCompilerWorkerCount);
+			}
 		}
 
 		void refreshSwapchain() {
@@ -88,13 +104,9 @@ namespace vku {
 
 			// kick off shader reload thread if need be
 			std::thread hotReloadThread;
-			Semaphore *initiateReload, *allowContinue;
-			std::atomic<bool> requestReloadFlag(false);
 			std::atomic<bool> reloadThreadKill(false);
 			if (shaderHotReloadEnabled) {
-				initiateReload = new Semaphore();
-				allowContinue = new Semaphore();
-				hotReloadThread = std::thread(&vku::hotReloadCheckingThread, context->device->shaderCache, initiateReload, allowContinue, &requestReloadFlag, &reloadThreadKill);
+				hotReloadThread = std::thread(&vku::hotReloadCheckingThread, context->device->shaderCache, &reloadThreadKill);
 			}
 
 			while (true) {
@@ -107,13 +119,16 @@ namespace vku {
 					glfwPollEvents();
 				}
 
+				{
+					// swap in pipelines that finished compiling in the background
+					ZoneScopedNC("Publish Pipelines", 0xFF5555);
+					context->device->pipelineCompiler->publish();
+				}
+
 				if (shaderHotReloadEnabled) {
-					ZoneScopedNC("Shader Hot-Reload Check", 0xFF5555);
-					if (requestReloadFlag.load()) {
-						requestReloadFlag.store(false);
-						initiateReload->release();
-						allowContinue->acquire();
-					}
+					// swap in pipelines for shaders recompiled in the background
+					ZoneScopedNC("Shader Hot-Reload", 0xFF5555);
+					context->device->shaderCache->applyReloads();
 				}
 
 				VulkanSwapchain& swapchain = *context->device->swapchain;
@@ -122,6 +137,30 @@ namespace vku {
 						ZoneScopedN("(VK) Waiting for Swapchain Flight Fences");
 						vkWaitForFences(*context->device, 1, &swapchain.inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 					}
+					{
+						// whatever the finished frame used can go now
+						ZoneScopedN("Deferred Deletion");
+						context->device->deletionQueue->collect(swapchain.swapChainLength);
+						context->device->uploadManager->collect();
+
+						DescriptorAllocatorStats descriptorStats = context->device->descriptorAllocator->getStats();
+						TracyPlot("Descriptor Pools", static_cast<int64_t>(descriptorStats.staticPools));
+						TracyPlot("Descriptor Sets", static_cast<int64_t>(descriptorStats.staticSets - descriptorStats.recycledSets));
+
+						MemoryStats memoryStats = context->device->memoryAllocator->getStats();
+						for (uint32_t c = 0; c < static_cast<uint32_t>(MemoryCategory::Count); c++) {
+							TracyPlot(memoryCategoryName(static_cast<MemoryCategory>(c)), static_cast<int64_t>(memoryStats.categoryBytes[c]));
+						}
+						VkDeviceSize localUsage = 0, localBudget = 0;
+						for (uint32_t h = 0; h < memoryStats.heapCount; h++) {
+							if (memoryStats.heaps[h].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+								localUsage += memoryStats.heaps[h].usage;
+								localBudget += memoryStats.heaps[h].budget;
+							}
+						}
+						TracyPlot("Device Local Usage", static_cast<int64_t>(localUsage));
+						TracyPlot("Device Local Budget", static_cast<int64_t>(localBudget));
+					}
 
 					uint32_t imageIndex;
 					VkResult result;
@@ -148,22 +187,33 @@ namespace vku {
 					// Mark the image as now being in use by this frame
 					swapchain.imagesInFlight[imageIndex] = swapchain.inFlightFences[currentFrame];
 
-					VkSubmitInfo submitInfo{};
-					submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-					VkSemaphore waitSemaphores[] = { swapchain.imageAvailableSemaphores[currentFrame] };
-					VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-					submitInfo.waitSemaphoreCount = 1;
-					submitInfo.pWaitSemaphores = waitSemaphores;
-					submitInfo.pWaitDstStageMask = waitStages;
-					submitInfo.commandBufferCount = 1;
-
 					VkCommandBuffer commandBuffer;
 					{
 						ZoneScopedN("Recording Commmand Buffer");
 						commandBuffer = this->draw(imageIndex);
 					}
+
+					// anything queued for upload so far goes out before the frame, which waits for it on the GPU only
+					uint64_t uploadValue = context->device->uploadManager->flush();
+
+					VkSubmitInfo submitInfo{};
+					submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+					VkSemaphore waitSemaphores[] = { swapchain.imageAvailableSemaphores[currentFrame], context->device->uploadManager->timeline };
+					VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+					uint64_t waitValues[] = { 0, uploadValue };
+					submitInfo.waitSemaphoreCount = 2;
+					submitInfo.pWaitSemaphores = waitSemaphores;
+					submitInfo.pWaitDstStageMask = waitStages;
+					submitInfo.commandBufferCount = 1;
 					submitInfo.pCommandBuffers = &commandBuffer;
 
+					// binary semaphores ignore their values
+					VkTimelineSemaphoreSubmitInfo timelineInfo{};
+					timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+					timelineInfo.waitSemaphoreValueCount = 2;
+					timelineInfo.pWaitSemaphoreValues = waitValues;
+					submitInfo.pNext = &timelineInfo;
+
 					VkSemaphore signalSemaphores[] = { swapchain.renderFinishedSemaphores[currentFrame] };
 					submitInfo.signalSemaphoreCount = 1;
 					submitInfo.pSignalSemaphores = signalSemaphores;
@@ -173,6 +223,7 @@ namespace vku {
 						if (vkQueueSubmit(context->device->graphicsQueue, 1, &submitInfo, swapchain.inFlightFences[currentFrame]) != VK_SUCCESS) {
 							throw std::runtime_error("Failed to submit draw command buffer!");
 						}
+						context->device->deletionQueue->frameSubmitted();
 					}
 
 					VkPresentInfoKHR presentInfo{};
@@ -216,7 +267,9 @@ namespace vku {
 				FrameMark;
 			}
 			reloadThreadKill.store(true);
-			hotReloadThread.join();
+			if (hotReloadThread.joinable()) {
+				hotReloadThread.join();
+			}
 			vkDeviceWaitIdle(*context->device);
 		}
 	};
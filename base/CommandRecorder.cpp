@@ -0,0 +1,221 @@
+#include "CommandRecorder.h"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+namespace vku {
+	uint32_t CommandRecorderStats::issued() const {
+		return pipelines.issued + descriptorSets.issued + vertexBuffers.issued + indexBuffers.issued + viewports.issued + scissors.issued + pushConstants.issued;
+	}
+
+	uint32_t CommandRecorderStats::elided() const {
+		return pipelines.elided + descriptorSets.elided + vertexBuffers.elided + indexBuffers.elided + viewports.elided + scissors.elided + pushConstants.elided;
+	}
+
+	CommandRecorderStats& CommandRecorderStats::operator+=(const CommandRecorderStats& other) {
+		Counter* counters[] = { &pipelines, &descriptorSets, &vertexBuffers, &indexBuffers, &viewports, &scissors, &pushConstants };
+		const Counter* otherCounters[] = { &other.pipelines, &other.descriptorSets, &other.vertexBuffers, &other.indexBuffers, &other.viewports, &other.scissors, &other.pushConstants };
+		for (size_t i = 0; i < std::size(counters); i++) {
+			counters[i]->issued += otherCounters[i]->issued;
+			counters[i]->elided += otherCounters[i]->elided;
+		}
+		draws += other.draws;
+		return *this;
+	}
+
+	CommandRecorderStats CommandRecorderStats::operator-(const CommandRecorderStats& other) const {
+		CommandRecorderStats result = *this;
+		Counter* counters[] = { &result.pipelines, &result.descriptorSets, &result.vertexBuffers, &result.indexBuffers, &result.viewports, &result.scissors, &result.pushConstants };
+		const Counter* otherCounters[] = { &other.pipelines, &other.descriptorSets, &other.vertexBuffers, &other.indexBuffers, &other.viewports, &other.scissors, &other.pushConstants };
+		for (size_t i = 0; i < std::size(counters); i++) {
+			counters[i]->issued -= otherCounters[i]->issued;
+			counters[i]->elided -= otherCounters[i]->elided;
+		}
+		result.draws -= other.draws;
+		return result;
+	}
+
+	CommandRecorder::CommandRecorder(VkCommandBuffer cmdbuf) {
+		this->cmdbuf = cmdbuf;
+		invalidate();
+	}
+
+	void CommandRecorder::bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+		VkPipeline& bound = pipelines[bindPointIndex(bindPoint)];
+		if (bound == pipeline) {
+			stats.pipelines.elided++;
+			return;
+		}
+		vkCmdBindPipeline(cmdbuf, bindPoint, pipeline);
+		bound = pipeline;
+		stats.pipelines.issued++;
+	}
+
+	void CommandRecorder::bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+		if (firstSet + setCount > MAX_SETS) {
+			throw std::runtime_error("Too many descriptor sets for the command recorder!");
+		}
+		BoundSet* bound = this->sets[bindPointIndex(bindPoint)];
+
+		// dynamic offsets are consumed in set order. only a single set's offsets can be matched up reliably.
+		bool redundant = true;
+		for (uint32_t k = 0; k < setCount; k++) {
+			const BoundSet& slot = bound[firstSet + k];
+			if (slot.layout != layout || slot.set != sets[k]) {
+				redundant = false;
+			}
+		}
+		if (redundant && dynamicOffsetCount > 0) {
+			const std::vector<uint32_t>& offsets = bound[firstSet].dynamicOffsets;
+			redundant = setCount == 1 && offsets.size() == dynamicOffsetCount && memcmp(offsets.data(), dynamicOffsets, sizeof(uint32_t) * dynamicOffsetCount) == 0;
+		}
+		else if (redundant) {
+			for (uint32_t k = 0; k < setCount; k++) {
+				redundant = redundant && bound[firstSet + k].dynamicOffsets.empty();
+			}
+		}
+		if (redundant) {
+			stats.descriptorSets.elided += setCount;
+			return;
+		}
+
+		vkCmdBindDescriptorSets(cmdbuf, bindPoint, layout, firstSet, setCount, sets, dynamicOffsetCount, dynamicOffsets);
+		stats.descriptorSets.issued += setCount;
+
+		// binding with an incompatible layout disturbs the other sets. we don't know which layouts are compatible, so forget any bound with another layout.
+		for (uint32_t k = 0; k < MAX_SETS; k++) {
+			if (bound[k].layout != layout) {
+				bound[k] = BoundSet{};
+			}
+		}
+		for (uint32_t k = 0; k < setCount; k++) {
+			BoundSet& slot = bound[firstSet + k];
+			slot.layout = layout;
+			slot.set = sets[k];
+			slot.dynamicOffsets.clear();
+		}
+		if (dynamicOffsetCount > 0) {
+			if (setCount == 1) {
+				bound[firstSet].dynamicOffsets.assign(dynamicOffsets, dynamicOffsets + dynamicOffsetCount);
+			}
+			else {
+				// offsets spread across several sets are never matched, so don't track those sets at all
+				for (uint32_t k = 0; k < setCount; k++) {
+					bound[firstSet + k] = BoundSet{};
+				}
+			}
+		}
+	}
+
+	void CommandRecorder::bindVertexBuffer(VkBuffer buffer, VkDeviceSize offset) {
+		if (vertexBuffer == buffer && vertexOffset == offset) {
+			stats.vertexBuffers.elided++;
+			return;
+		}
+		vkCmdBindVertexBuffers(cmdbuf, 0, 1, &buffer, &offset);
+		vertexBuffer = buffer;
+		vertexOffset = offset;
+		stats.vertexBuffers.issued++;
+	}
+
+	void CommandRecorder::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+		if (indexBuffer == buffer && indexOffset == offset && this->indexType == indexType) {
+			stats.indexBuffers.elided++;
+			return;
+		}
+		vkCmdBindIndexBuffer(cmdbuf, buffer, offset, indexType);
+		indexBuffer = buffer;
+		indexOffset = offset;
+		this->indexType = indexType;
+		stats.indexBuffers.issued++;
+	}
+
+	void CommandRecorder::setViewport(const VkViewport& viewport) {
+		if (hasViewport && memcmp(&this->viewport, &viewport, sizeof(VkViewport)) == 0) {
+			stats.viewports.elided++;
+			return;
+		}
+		vkCmdSetViewport(cmdbuf, 0, 1, &viewport);
+		this->viewport = viewport;
+		hasViewport = true;
+		stats.viewports.issued++;
+	}
+
+	void CommandRecorder::setScissor(const VkRect2D& scissor) {
+		if (hasScissor && memcmp(&this->scissor, &scissor, sizeof(VkRect2D)) == 0) {
+			stats.scissors.elided++;
+			return;
+		}
+		vkCmdSetScissor(cmdbuf, 0, 1, &scissor);
+		this->scissor = scissor;
+		hasScissor = true;
+		stats.scissors.issued++;
+	}
+
+	void CommandRecorder::pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data) {
+		if (offset + size > MAX_PUSH_CONSTANT_SIZE) {
+			throw std::runtime_error("Push constants out of the command recorder's range!");
+		}
+
+		// values pushed through another layout or for other stages are not known to still be visible
+		if (layout != pushLayout || stages != pushStages) {
+			memset(pushValid, 0, sizeof(pushValid));
+			pushLayout = layout;
+			pushStages = stages;
+		}
+
+		bool redundant = memcmp(pushData + offset, data, size) == 0;
+		for (uint32_t b = offset; b < offset + size && redundant; b++) {
+			redundant = (pushValid[b / 64] >> (b % 64)) & 1;
+		}
+		if (redundant) {
+			stats.pushConstants.elided++;
+			return;
+		}
+
+		vkCmdPushConstants(cmdbuf, layout, stages, offset, size, data);
+		memcpy(pushData + offset, data, size);
+		for (uint32_t b = offset; b < offset + size; b++) {
+			pushValid[b / 64] |= 1ull << (b % 64);
+		}
+		stats.pushConstants.issued++;
+	}
+
+	void CommandRecorder::drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+		vkCmdDrawIndexed(cmdbuf, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		stats.draws++;
+	}
+
+	void CommandRecorder::drawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride) {
+		vkCmdDrawIndexedIndirectCount(cmdbuf, buffer, offset, countBuffer, countOffset, maxDrawCount, stride);
+		stats.draws++;
+	}
+
+	void CommandRecorder::invalidate() {
+		for (uint32_t p = 0; p < 2; p++) {
+			pipelines[p] = VK_NULL_HANDLE;
+			for (BoundSet& slot : sets[p]) {
+				slot = BoundSet{};
+			}
+		}
+
+		vertexBuffer = VK_NULL_HANDLE;
+		vertexOffset = 0;
+		indexBuffer = VK_NULL_HANDLE;
+		indexOffset = 0;
+		indexType = VK_INDEX_TYPE_UINT32;
+
+		hasViewport = false;
+		hasScissor = false;
+
+		pushLayout = VK_NULL_HANDLE;
+		pushStages = 0;
+		memset(pushData, 0, sizeof(pushData));
+		memset(pushValid, 0, sizeof(pushValid));
+	}
+
+	uint32_t CommandRecorder::bindPointIndex(VkPipelineBindPoint bindPoint) {
+		return bindPoint == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0;
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vku {
+	struct CommandRecorderStats {
+		struct Counter {
+			// calls that reached the command buffer
+			uint32_t issued = 0;
+			// calls skipped because the state was already bound
+			uint32_t elided = 0;
+		};
+
+		Counter pipelines;
+		Counter descriptorSets;
+		Counter vertexBuffers;
+		Counter indexBuffers;
+		Counter viewports;
+		Counter scissors;
+		Counter pushConstants;
+		uint32_t draws = 0;
+
+		uint32_t issued() const;
+		uint32_t elided() const;
+
+		CommandRecorderStats& operator+=(const CommandRecorderStats& other);
+		// what was recorded between two snapshots of the same recorder
+		CommandRecorderStats operator-(const CommandRecorderStats& other) const;
+	};
+
+	// thin wrapper around a VkCommandBuffer that remembers the bound pipeline, descriptor sets, vertex/index buffers,
+	// viewport/scissor and push constant bytes, and drops calls that wouldn't change any of them.
+	// state only carries over within one command buffer, so use one recorder per command buffer.
+	// anything recorded on the raw handle behind its back must be followed by invalidate().
+	struct CommandRecorder {
+		// the most descriptor sets a pipeline layout may use in this engine
+		static const uint32_t MAX_SETS = 8;
+		// the push constant range every pipeline layout shares with the scene
+		static const uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+
+		VkCommandBuffer cmdbuf;
+
+		CommandRecorderStats stats;
+
+		CommandRecorder(VkCommandBuffer cmdbuf);
+
+		operator VkCommandBuffer() const { return cmdbuf; }
+
+		void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline);
+		void bindDescriptorSets(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount = 0, const uint32_t* dynamicOffsets = nullptr);
+		void bindVertexBuffer(VkBuffer buffer, VkDeviceSize offset = 0);
+		void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+		void setViewport(const VkViewport& viewport);
+		void setScissor(const VkRect2D& scissor);
+		void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+		void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+		// counts as one draw, however many the GPU ends up issuing
+		void drawIndexedIndirectCount(VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride);
+
+		// forget all tracked state, so the next call of each kind is issued
+		void invalidate();
+
+	private:
+		struct BoundSet {
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			std::vector<uint32_t> dynamicOffsets;
+		};
+
+		// graphics and compute state are tracked separately, as Vulkan does
+		VkPipeline pipelines[2];
+		BoundSet sets[2][MAX_SETS];
+
+		VkBuffer vertexBuffer;
+		VkDeviceSize vertexOffset;
+		VkBuffer indexBuffer;
+		VkDeviceSize indexOffset;
+		VkIndexType indexType;
+
+		bool hasViewport;
+		VkViewport viewport;
+		bool hasScissor;
+		VkRect2D scissor;
+
+		VkPipelineLayout pushLayout;
+		VkShaderStageFlags pushStages;
+		uint8_t pushData[MAX_PUSH_CONSTANT_SIZE];
+		// one bit per byte of pushData that holds a pushed value
+		uint64_t pushValid[MAX_PUSH_CONSTANT_SIZE / 64];
+
+		static uint32_t bindPointIndex(VkPipelineBindPoint bindPoint);
+	};
+}
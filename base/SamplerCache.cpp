@@ -0,0 +1,36 @@
+#include "SamplerCache.h"
+
+#include "VulkanDevice.h"
+
+namespace vku {
+	SamplerCache::SamplerCache(VulkanDevice* device) {
+		this->device = device;
+	}
+
+	SamplerCache::~SamplerCache() {
+		// only called once the device is idle
+		for (auto& [info, sampler] : samplers) {
+			delete sampler;
+		}
+	}
+
+	VulkanSampler* SamplerCache::get(const VulkanSamplerInfo& info) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = samplers.find(info);
+		if (it != samplers.end()) {
+			hits++;
+			return it->second;
+		}
+
+		misses++;
+		VulkanSampler* sampler = new VulkanSampler(device, info);
+		samplers[info] = sampler;
+		return sampler;
+	}
+
+	size_t SamplerCache::size() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return samplers.size();
+	}
+}
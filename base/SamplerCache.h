@@ -0,0 +1,32 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+
+#include "VulkanTexture.h"
+
+namespace vku {
+	struct VulkanDevice;
+
+	// hands out one shared VkSampler per distinct VulkanSamplerInfo. thread safe.
+	// scenes only ever use a handful of sampler configurations, so samplers are never released;
+	// they live until the device is destroyed, and textures just borrow them.
+	struct SamplerCache {
+		VulkanDevice* device;
+
+		// statistics
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+
+		SamplerCache(VulkanDevice* device);
+		~SamplerCache();
+
+		VulkanSampler* get(const VulkanSamplerInfo& info);
+
+		size_t size();
+
+	private:
+		std::mutex mutex;
+		std::map<VulkanSamplerInfo, VulkanSampler*> samplers;
+	};
+}
@@ -2,6 +2,7 @@
 
 #include "VulkanTexture.h"
 #include "VulkanDevice.h"
+#include "SamplerCache.h"
 
 namespace vku {
 
@@ -16,29 +17,13 @@ namespace vku {
 			});
 
 		VkDeviceSize imageSize = 1 * 1 * 4;
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(*device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(*device, stagingBufferMemory);
-
-		// create image and load from buffer
-		pixTex->image->loadFromBuffer(stagingBuffer);
-
-		vkDestroyBuffer(*device, stagingBuffer, nullptr);
-		vkFreeMemory(*device, stagingBufferMemory, nullptr);
+		pixTex->image->upload(pixels, imageSize);
 
 		VulkanImageViewInfo viewInfo{};
 		pixTex->image->writeImageViewInfo(&viewInfo);
 		pixTex->view = new VulkanImageView(device, viewInfo);
 
-		pixTex->sampler = new VulkanSampler(device, VulkanSamplerInfo{});
+		pixTex->sampler = device->samplerCache->get(VulkanSamplerInfo{});
 
 	}
 
@@ -0,0 +1,46 @@
+#include "UniformRing.h"
+
+#include <stdexcept>
+
+#include "VulkanDevice.h"
+#include "util/DeletionQueue.h"
+
+namespace vku {
+	UniformRing::UniformRing(VulkanDevice* device, VkDeviceSize frameSize, uint32_t frameCount) : ranges(0) {
+		this->device = device;
+		this->frameCount = frameCount;
+		this->alignment = device->supportInfo.deviceProperties.limits.minUniformBufferOffsetAlignment;
+		// keeps every slice aligned as well
+		this->frameSize = align(frameSize);
+		this->ranges.grow(this->frameSize);
+
+		device->createBuffer(this->frameSize * frameCount,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer, allocation, MemoryCategory::Uniform);
+		mapped = static_cast<uint8_t*>(allocation.mapped);
+	}
+
+	UniformRing::~UniformRing() {
+		device->destroyBuffer(buffer, allocation);
+	}
+
+	VkDeviceSize UniformRing::reserve(VkDeviceSize size) {
+		uint64_t offset = ranges.allocate(align(size), alignment);
+		if (offset == RangeAllocator::INVALID) {
+			throw std::runtime_error("Uniform ring is out of space!");
+		}
+		return offset;
+	}
+
+	void UniformRing::release(VkDeviceSize reservedOffset, VkDeviceSize size) {
+		device->deletionQueue->push([this, reservedOffset, size]() {
+			ranges.free(reservedOffset, align(size));
+		});
+	}
+
+	UniformAllocation UniformRing::get(uint32_t frame, VkDeviceSize reservedOffset) {
+		VkDeviceSize offset = frameSize * frame + reservedOffset;
+		return { mapped + offset, static_cast<uint32_t>(offset) };
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "memory/MemoryAllocator.h"
+#include "memory/RangeAllocator.h"
+
+namespace vku {
+	struct VulkanDevice;
+
+	struct UniformAllocation {
+		// host address to write the uniform to
+		void* data;
+		// dynamic offset to bind the ring's descriptor with
+		uint32_t offset;
+	};
+
+	// one host visible uniform buffer, mapped for its whole lifetime and split into a slice per frame.
+	// descriptors point at it as UNIFORM_BUFFER_DYNAMIC and pick their data with dynamic offsets,
+	// so writing a uniform is a memcpy, with no driver calls and no buffer per uniform.
+	struct UniformRing {
+		VulkanDevice* device;
+
+		VkBuffer buffer;
+		MemoryAllocation allocation;
+
+		VkDeviceSize frameSize;
+		uint32_t frameCount;
+		// minUniformBufferOffsetAlignment
+		VkDeviceSize alignment;
+
+		UniformRing(VulkanDevice* device, VkDeviceSize frameSize, uint32_t frameCount);
+		~UniformRing();
+
+		// reserves `size` bytes at the same offset of every slice, for uniforms that are rewritten every frame.
+		// returns the offset within a slice, which stays reserved until released.
+		VkDeviceSize reserve(VkDeviceSize size);
+		// gives a reservation back once the frames in flight are done with it. size must be the one it was reserved with.
+		void release(VkDeviceSize reservedOffset, VkDeviceSize size);
+		// frame i's copy of a reserved range
+		UniformAllocation get(uint32_t frame, VkDeviceSize reservedOffset);
+
+	private:
+		uint8_t* mapped;
+		// reserved ranges of a slice; the same in every slice
+		RangeAllocator ranges;
+
+		VkDeviceSize align(VkDeviceSize size) const { return (size + alignment - 1) & ~(alignment - 1); }
+	};
+}
@@ -0,0 +1,356 @@
+#include "UploadManager.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <Tracy.hpp>
+
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+
+namespace vku {
+	UploadManager::UploadManager(VulkanDevice* device, VkDeviceSize ringSize) {
+		this->device = device;
+		this->ringSize = ringSize;
+
+		graphicsFamily = device->supportInfo.graphicsFamily.value();
+		dedicatedTransfer = device->supportInfo.transferFamily.has_value();
+		transferFamily = dedicatedTransfer ? device->supportInfo.transferFamily.value() : graphicsFamily;
+
+		transferPool = createPool(transferFamily);
+		if (dedicatedTransfer) {
+			graphicsPool = createPool(graphicsFamily);
+		}
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		if (vkCreateSemaphore(*device, &semaphoreInfo, nullptr, &timeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create upload timeline semaphore!");
+		}
+
+		// staging memory is written once and read once by the GPU, and lives as long as the device
+		device->createBuffer(ringSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			ring, ringAllocation, MemoryCategory::Staging);
+	}
+
+	UploadManager::~UploadManager() {
+		finish();
+
+		device->destroyBuffer(ring, ringAllocation);
+		vkDestroySemaphore(*device, timeline, nullptr);
+		vkDestroyCommandPool(*device, transferPool, nullptr);
+		if (graphicsPool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(*device, graphicsPool, nullptr);
+		}
+	}
+
+	void UploadManager::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+		memcpy(stageBuffer(buffer, offset, size), data, static_cast<size_t>(size));
+	}
+
+	void* UploadManager::stageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+		VkBuffer srcBuffer;
+		VkDeviceSize srcOffset;
+		void* mapped = stage(size, 4, srcBuffer, srcOffset);
+		beginBatch();
+
+		VkBufferCopy region{};
+		region.srcOffset = srcOffset;
+		region.dstOffset = offset;
+		region.size = size;
+		vkCmdCopyBuffer(current.transferCmd, srcBuffer, buffer, 1, &region);
+
+		if (dedicatedTransfer) {
+			// hand the range over to the graphics queue
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			barrier.buffer = buffer;
+			barrier.offset = offset;
+			barrier.size = size;
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier(current.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(current.graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		}
+
+		uploadedBytes += size;
+		return mapped;
+	}
+
+	void UploadManager::uploadImage(VulkanImage* image, const void* data, VkDeviceSize size) {
+		memcpy(stageImage(image, size), data, static_cast<size_t>(size));
+	}
+
+	void* UploadManager::stageImage(VulkanImage* image, VkDeviceSize size) {
+		const VulkanImageInfo& info = image->getInfo();
+
+		VkBuffer srcBuffer;
+		VkDeviceSize srcOffset;
+		// a multiple of every texel size we upload
+		void* mapped = stage(size, 16, srcBuffer, srcOffset);
+		beginBatch();
+
+		bool mips = info.mipLevels > 1;
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = *image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = info.mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = info.arrayLayers;
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(current.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = srcOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = info.arrayLayers;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { info.width, info.height, 1 };
+		vkCmdCopyBufferToImage(current.transferCmd, srcBuffer, *image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		// mips are blitted, which transfer queues can't do
+		VkCommandBuffer finishCmd = current.transferCmd;
+		if (dedicatedTransfer) {
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = mips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier(current.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = mips ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(current.graphicsCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			finishCmd = current.graphicsCmd;
+		}
+
+		if (mips) {
+			image->recordMipmaps(finishCmd);
+		}
+		else if (!dedicatedTransfer) {
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(finishCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		}
+
+		uploadedBytes += size;
+		return mapped;
+	}
+
+	uint64_t UploadManager::flush() {
+		if (current.transferCmd == VK_NULL_HANDLE) {
+			return submittedValue;
+		}
+		ZoneScopedN("Submit Uploads");
+
+		if (!dedicatedTransfer) {
+			// later submissions on the graphics queue read the uploads through this barrier
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(current.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		auto submit = [this](VkQueue queue, VkCommandBuffer cmd, uint64_t waitValue, uint64_t signalValue) {
+			vkEndCommandBuffer(cmd);
+
+			VkTimelineSemaphoreSubmitInfo timelineInfo{};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount = waitValue > 0 ? 1 : 0;
+			timelineInfo.pWaitSemaphoreValues = &waitValue;
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+			VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.waitSemaphoreCount = waitValue > 0 ? 1 : 0;
+			submitInfo.pWaitSemaphores = &timeline;
+			submitInfo.pWaitDstStageMask = &waitStage;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &cmd;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &timeline;
+
+			if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to submit upload batch!");
+			}
+		};
+
+		submit(device->transferQueue, current.transferCmd, 0, ++submittedValue);
+		if (dedicatedTransfer) {
+			uint64_t copied = submittedValue;
+			submit(device->graphicsQueue, current.graphicsCmd, copied, ++submittedValue);
+		}
+
+		current.value = submittedValue;
+		current.ringEnd = head;
+		inFlight.push_back(current);
+		current = Batch{};
+		batchesSubmitted++;
+
+		return submittedValue;
+	}
+
+	void UploadManager::wait(uint64_t value) {
+		if (value > completedValue) {
+			ZoneScopedN("Waiting for Uploads");
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &value;
+			vkWaitSemaphores(*device, &waitInfo, UINT64_MAX);
+		}
+		collect();
+	}
+
+	void UploadManager::finish() {
+		wait(flush());
+	}
+
+	void UploadManager::collect() {
+		vkGetSemaphoreCounterValue(*device, timeline, &completedValue);
+		while (!inFlight.empty() && inFlight.front().value <= completedValue) {
+			retire(inFlight.front());
+			inFlight.pop_front();
+		}
+	}
+
+	void UploadManager::beginBatch() {
+		if (current.transferCmd != VK_NULL_HANDLE) {
+			return;
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		allocInfo.commandPool = transferPool;
+		vkAllocateCommandBuffers(*device, &allocInfo, &current.transferCmd);
+		vkBeginCommandBuffer(current.transferCmd, &beginInfo);
+
+		if (dedicatedTransfer) {
+			allocInfo.commandPool = graphicsPool;
+			vkAllocateCommandBuffers(*device, &allocInfo, &current.graphicsCmd);
+			vkBeginCommandBuffer(current.graphicsCmd, &beginInfo);
+		}
+	}
+
+	void UploadManager::retire(Batch& batch) {
+		vkFreeCommandBuffers(*device, transferPool, 1, &batch.transferCmd);
+		if (batch.graphicsCmd != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(*device, graphicsPool, 1, &batch.graphicsCmd);
+		}
+		for (auto& [buffer, allocation] : batch.oversized) {
+			device->destroyBuffer(buffer, allocation);
+		}
+		// batches finish in order, so everything before this one's end is free again
+		tail = batch.ringEnd;
+	}
+
+	void* UploadManager::stage(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& srcBuffer, VkDeviceSize& srcOffset) {
+		if (size > ringSize / 2) {
+			// would stall the ring for too long. goes through the allocator's linear staging path instead.
+			VkBuffer buffer;
+			MemoryAllocation allocation;
+			device->createStagingBuffer(size, buffer, allocation);
+			current.oversized.push_back({ buffer, allocation });
+			oversizedUploads++;
+
+			srcBuffer = buffer;
+			srcOffset = 0;
+			return allocation.mapped;
+		}
+
+		while (!allocateRing(size, alignment, srcOffset)) {
+			// out of space: wait for the oldest batch to give some back
+			if (inFlight.empty()) {
+				flush();
+			}
+			wait(inFlight.front().value);
+		}
+
+		srcBuffer = ring;
+		return static_cast<uint8_t*>(ringAllocation.mapped) + srcOffset;
+	}
+
+	bool UploadManager::allocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+		if (current.transferCmd == VK_NULL_HANDLE && inFlight.empty()) {
+			head = 0;
+			tail = 0;
+		}
+
+		offset = (head + alignment - 1) / alignment * alignment;
+		if (head >= tail) {
+			// free space is [head, ringSize) and [0, tail)
+			if (offset + size <= ringSize) {
+				head = offset + size;
+				return true;
+			}
+			// wrap around. strictly below tail, so a full ring never looks empty.
+			if (size < tail) {
+				offset = 0;
+				head = size;
+				return true;
+			}
+			return false;
+		}
+
+		// free space is [head, tail)
+		if (offset + size < tail) {
+			head = offset + size;
+			return true;
+		}
+		return false;
+	}
+
+	VkCommandPool UploadManager::createPool(uint32_t family) {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = family;
+
+		VkCommandPool pool;
+		if (vkCreateCommandPool(*device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create upload command pool!");
+		}
+		return pool;
+	}
+}
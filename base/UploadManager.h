@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "memory/MemoryAllocator.h"
+
+namespace vku {
+	struct VulkanDevice;
+	struct VulkanImage;
+
+	// uploads buffers and images without stalling on each one. data is copied into a persistently mapped staging ring,
+	// and the copies, layout transitions and mip generation are recorded into one batch that is submitted as a whole.
+	// copies run on the dedicated transfer queue when the device has one; ownership then moves to the graphics queue,
+	// which also blits the mips. every batch signals a timeline semaphore, which frames wait on and which retires the ring space.
+	// use it from the render thread only.
+	struct UploadManager {
+		VulkanDevice* device;
+
+		VkBuffer ring;
+		MemoryAllocation ringAllocation;
+		VkDeviceSize ringSize;
+
+		// signalled with a new value by every submitted batch
+		VkSemaphore timeline;
+
+		// statistics
+		uint64_t uploadedBytes = 0;
+		uint32_t batchesSubmitted = 0;
+		uint32_t oversizedUploads = 0;
+
+		UploadManager(VulkanDevice* device, VkDeviceSize ringSize);
+		~UploadManager();
+
+		void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+		// returns staging memory to fill before the batch is flushed
+		void* stageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+
+		// fills mip 0 of every layer, generates the other mips, and leaves the image in SHADER_READ_ONLY_OPTIMAL
+		void uploadImage(VulkanImage* image, const void* data, VkDeviceSize size);
+		void* stageImage(VulkanImage* image, VkDeviceSize size);
+
+		// submits the recorded batch, if there is one. returns the timeline value that marks everything uploaded so far as done.
+		uint64_t flush();
+		// blocks until the timeline reaches value
+		void wait(uint64_t value);
+		// flush and wait
+		void finish();
+		// gives back the staging space of finished batches. call once per frame.
+		void collect();
+
+	private:
+		struct Batch {
+			VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+			// only with a dedicated transfer queue: acquires ownership and generates mips
+			VkCommandBuffer graphicsCmd = VK_NULL_HANDLE;
+			uint64_t value = 0;
+			// where the ring's head was when the batch was submitted
+			VkDeviceSize ringEnd = 0;
+			// uploads too big for the ring
+			std::vector<std::pair<VkBuffer, MemoryAllocation>> oversized;
+		};
+
+		bool dedicatedTransfer;
+		uint32_t transferFamily;
+		uint32_t graphicsFamily;
+		VkCommandPool transferPool;
+		VkCommandPool graphicsPool = VK_NULL_HANDLE;
+
+		uint64_t submittedValue = 0;
+		uint64_t completedValue = 0;
+
+		// the batch being recorded, if transferCmd isn't null
+		Batch current;
+		// submitted, oldest first
+		std::deque<Batch> inFlight;
+
+		VkDeviceSize head = 0;
+		VkDeviceSize tail = 0;
+
+		void beginBatch();
+		void retire(Batch& batch);
+		// staging memory for size bytes, from the ring if it fits. returns the buffer and offset to copy from.
+		void* stage(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& srcBuffer, VkDeviceSize& srcOffset);
+		bool allocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		VkCommandPool createPool(uint32_t family);
+	};
+}
@@ -8,6 +8,8 @@
 #include "VulkanDevice.h"
 #include "VulkanUniform.h"
 #include "VulkanTexture.h"
+#include "descriptor/DescriptorAllocator.h"
+#include "descriptor/DescriptorWriter.h"
 
 namespace vku {
 	VulkanDescriptorSetLayout::VulkanDescriptorSetLayout(VulkanDevice *device, std::vector<DescriptorLayout> descriptorLayouts) {
@@ -17,7 +19,7 @@ namespace vku {
 		for (auto& descriptorLayout : descriptorLayouts) {
 			VkDescriptorSetLayoutBinding binding{};
 			binding.binding = bindingIndex++;
-			binding.descriptorCount = 1;
+			binding.descriptorCount = descriptorLayout.count;
 			binding.pImmutableSamplers = nullptr;
 			binding.descriptorType = descriptorLayout.type;
 			binding.stageFlags = descriptorLayout.stageFlags;
@@ -38,60 +40,42 @@ namespace vku {
 		}
 
 		this->device = device;
+		this->bindings = descriptorLayouts;
 	}
 
 	VulkanDescriptorSetLayout::~VulkanDescriptorSetLayout() {
+		delete updateTemplate;
 		vkDestroyDescriptorSetLayout(*device, handle, nullptr);
 	}
 
+	DescriptorUpdateTemplate* VulkanDescriptorSetLayout::getUpdateTemplate() {
+		if (updateTemplate == nullptr) {
+			updateTemplate = new DescriptorUpdateTemplate(this);
+		}
+		return updateTemplate;
+	}
+
 	VulkanDescriptorSet::VulkanDescriptorSet(VulkanDescriptorSetLayout* layout) {
 		this->device = layout->device;
-
-		VkDescriptorSetAllocateInfo info{};
-		info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		info.descriptorPool = device->descriptorPool;
-		info.descriptorSetCount = 1;
-		info.pSetLayouts = &layout->handle;
-
-		vkAllocateDescriptorSets(*device, &info, &handle);
+		this->bindings = layout->bindings;
+		handle = device->descriptorAllocator->allocate(layout);
 	}
 	VulkanDescriptorSet::~VulkanDescriptorSet() {
-		vkFreeDescriptorSets(*device, device->descriptorPool, 1, &handle);
+		device->descriptorAllocator->release(bindings, handle);
 	}
 
 	void VulkanDescriptorSet::write(uint32_t binding, VulkanUniform* uniform) {
-		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = uniform->buffer;
-		bufferInfo.offset = 0;
-		bufferInfo.range = uniform->dataSize;
-
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = handle;
-		descriptorWrite.dstBinding = binding;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pBufferInfo = &bufferInfo;
-
-		vkUpdateDescriptorSets(*device, 1, &descriptorWrite, 0, nullptr);
+		DescriptorWriter writer(device);
+		writer.write(this, binding, uniform);
 	}
 
 	void VulkanDescriptorSet::write(uint32_t binding, VulkanTexture* texture) {
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = *texture->view;
-		imageInfo.sampler = *texture->sampler;
-
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = handle;
-		descriptorWrite.dstBinding = binding;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pImageInfo = &imageInfo;
+		DescriptorWriter writer(device);
+		writer.write(this, binding, texture);
+	}
 
-		vkUpdateDescriptorSets(*device, 1, &descriptorWrite, 0, nullptr);
+	void VulkanDescriptorSet::write(uint32_t binding, VkBuffer buffer, VkDeviceSize range, VkDescriptorType type) {
+		DescriptorWriter writer(device);
+		writer.write(this, binding, buffer, range, type);
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <tuple>
 
 #include <vulkan/vulkan.h>
 
@@ -8,21 +9,34 @@ namespace vku {
 	struct VulkanDevice;
 	struct VulkanUniform;
 	struct VulkanTexture;
+	struct DescriptorUpdateTemplate;
 
 	struct DescriptorLayout {
 		VkDescriptorType type;
 		VkShaderStageFlags stageFlags;
+		// array size of the binding
+		uint32_t count = 1;
+
+		bool operator==(const DescriptorLayout& other) const { return type == other.type && stageFlags == other.stageFlags && count == other.count; }
+		bool operator<(const DescriptorLayout& other) const { return std::tie(type, stageFlags, count) < std::tie(other.type, other.stageFlags, other.count); }
 	};
 
 	struct VulkanDescriptorSetLayout {
 		VkDescriptorSetLayout handle;
 
 		VulkanDevice* device;
+		std::vector<DescriptorLayout> bindings;
 
 		VulkanDescriptorSetLayout(VulkanDevice* device, std::vector<DescriptorLayout> descriptorLayouts);
 		~VulkanDescriptorSetLayout();
 
+		// created on first use, to write whole sets of this layout in one call
+		DescriptorUpdateTemplate* getUpdateTemplate();
+
 		operator VkDescriptorSetLayout() const { return handle; }
+
+	private:
+		DescriptorUpdateTemplate* updateTemplate = nullptr;
 	};
 
 	struct VulkanDescriptorSet {
@@ -30,11 +44,16 @@ namespace vku {
 
 		VkDescriptorSet handle;
 
+		// of the layout; tells writes their descriptor type, and lets the set be recycled once released
+		std::vector<DescriptorLayout> bindings;
+
 		VulkanDescriptorSet(VulkanDescriptorSetLayout* layout);
 		~VulkanDescriptorSet();
 
+		// each write is its own vkUpdateDescriptorSets call. use a DescriptorWriter to batch many.
 		void write(uint32_t binding, VulkanUniform* uniform);
 		void write(uint32_t binding, VulkanTexture* uniform);
+		void write(uint32_t binding, VkBuffer buffer, VkDeviceSize range, VkDescriptorType type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 
 		operator VkDescriptorSet() const { return handle; }
 	};
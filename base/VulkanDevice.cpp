@@ -3,6 +3,7 @@
 #include "VulkanDevice.h"
 
 #include <set>
+#include <algorithm>
 #include <optional>
 #include <stdexcept>
 #include <iostream>
@@ -11,6 +12,16 @@
 #include "VulkanSwapchain.h"
 #include "shader/ShaderCache.h"
 #include "TextureCommons.h"
+#include "SamplerCache.h"
+#include "UniformRing.h"
+#include "VulkanPipelineCache.h"
+#include "pipeline/PipelineRegistry.h"
+#include "pipeline/PipelineCompiler.h"
+#include "pipeline/PipelineUsageLog.h"
+#include "util/DeletionQueue.h"
+#include "descriptor/DescriptorAllocator.h"
+#include "descriptor/BindlessTextureTable.h"
+#include "descriptor/DescriptorLayoutCache.h"
 
 namespace vku {
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*> deviceExtensions) {
@@ -77,6 +88,10 @@ namespace vku {
 					supportInfo.presentFamily = i;
 				}
 
+				if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+					supportInfo.transferFamily = i;
+				}
+
 				i++;
 			}
 		}
@@ -85,13 +100,44 @@ namespace vku {
 		vkGetPhysicalDeviceProperties(physicalDevice, &supportInfo.deviceProperties);
 		vkGetPhysicalDeviceFeatures(physicalDevice, &supportInfo.deviceFeatures);
 
-		// fetch KHR raytracing support
+		// fetch KHR raytracing and descriptor indexing support
 		supportInfo.rtFeatures = VkPhysicalDeviceRayTracingFeaturesKHR{};
 		supportInfo.rtFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_FEATURES_KHR;
+		supportInfo.descriptorIndexingFeatures = VkPhysicalDeviceDescriptorIndexingFeatures{};
+		supportInfo.descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		supportInfo.rtFeatures.pNext = &supportInfo.descriptorIndexingFeatures;
 		VkPhysicalDeviceFeatures2 features2{};
 		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 		features2.pNext = &supportInfo.rtFeatures;
 		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+		// the chain would dangle once the struct is copied
+		supportInfo.rtFeatures.pNext = nullptr;
+
+		supportInfo.descriptorIndexingProperties = VkPhysicalDeviceDescriptorIndexingProperties{};
+		supportInfo.descriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &supportInfo.descriptorIndexingProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+		supportInfo.descriptorIndexingProperties.pNext = nullptr;
+
+		const VkPhysicalDeviceDescriptorIndexingFeatures& indexing = supportInfo.descriptorIndexingFeatures;
+		supportInfo.bindlessSupported = indexing.runtimeDescriptorArray && indexing.descriptorBindingPartiallyBound
+			&& indexing.descriptorBindingSampledImageUpdateAfterBind && indexing.shaderSampledImageArrayNonUniformIndexing;
+
+		// timelineSemaphore and drawIndirectCount only have Vulkan 1.2 feature bits, which a 1.1 device can't be asked for
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		supportInfo.vulkan12Supported = supportInfo.deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+		if (supportInfo.vulkan12Supported) {
+			features2.pNext = &vulkan12Features;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+		}
+		supportInfo.timelineSemaphoreSupported = vulkan12Features.timelineSemaphore;
+		supportInfo.gpuDrivenSupported = vulkan12Features.drawIndirectCount
+			&& supportInfo.deviceFeatures.multiDrawIndirect && supportInfo.deviceFeatures.drawIndirectFirstInstance;
+
+		supportInfo.memoryBudgetSupported = checkDeviceExtensionSupport(physicalDevice, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME });
 
 
 		// get max MSAA sample count
@@ -122,6 +168,14 @@ namespace vku {
 		if (!hasGraphicsQueueFamily || !hasPresentQueueFamily || !swapChainAdequate || !supportInfo.deviceFeatures.samplerAnisotropy) {
 			return -1;
 		}
+		if (!supportInfo.vulkan12Supported || !supportInfo.timelineSemaphoreSupported) {
+			uint32_t version = supportInfo.deviceProperties.apiVersion;
+			std::cerr << "Skipping " << supportInfo.deviceProperties.deviceName << ": it supports Vulkan "
+				<< VK_VERSION_MAJOR(version) << "." << VK_VERSION_MINOR(version)
+				<< (supportInfo.vulkan12Supported ? " without timeline semaphores" : "")
+				<< ", but Vulkan 1.2 with timeline semaphores is required." << std::endl;
+			return -1;
+		}
 
 		// begin scoring.
 
@@ -171,7 +225,7 @@ namespace vku {
 				}
 			}
 			if (this->physicalDevice == VK_NULL_HANDLE) {
-				throw std::runtime_error("Failed to find a suitable GPU!");
+				throw std::runtime_error("Failed to find a suitable GPU! It needs Vulkan 1.2 with timeline semaphores, a graphics and present queue, and anisotropic filtering.");
 			}
 		}
 
@@ -179,6 +233,9 @@ namespace vku {
 		{
 			std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 			std::set<uint32_t> uniqueQueueFamilies = { supportInfo.graphicsFamily.value(), supportInfo.presentFamily.value() };
+			if (supportInfo.transferFamily.has_value()) {
+				uniqueQueueFamilies.insert(supportInfo.transferFamily.value());
+			}
 
 			float queuePriority = 1.0f;
 			for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -196,6 +253,10 @@ namespace vku {
 			deviceFeatures.tessellationShader = VK_TRUE;
 			deviceFeatures.fillModeNonSolid = VK_TRUE;
 			deviceFeatures.wideLines = VK_TRUE;
+			if (supportInfo.gpuDrivenSupported) {
+				deviceFeatures.multiDrawIndirect = VK_TRUE;
+				deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+			}
 
 			VkDeviceCreateInfo createInfo{};
 			createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -204,9 +265,34 @@ namespace vku {
 
 			createInfo.pEnabledFeatures = &deviceFeatures;
 
-			// enable all the extensions we need
-			createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-			createInfo.ppEnabledExtensionNames = extensions.data();
+			// all Vulkan 1.2 features go in one struct, which can't be chained with the per-feature structs it replaces
+			VkPhysicalDeviceVulkan12Features vulkan12Features{};
+			vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			createInfo.pNext = &vulkan12Features;
+
+			// timeline semaphores track uploads. they are required by Vulkan 1.2.
+			vulkan12Features.timelineSemaphore = VK_TRUE;
+
+			// descriptor indexing, for the bindless texture table
+			if (supportInfo.bindlessSupported) {
+				vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+				vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+				vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+				vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			}
+
+			// indirect count draws, for GPU culling
+			if (supportInfo.gpuDrivenSupported) {
+				vulkan12Features.drawIndirectCount = VK_TRUE;
+			}
+
+			// enable all the extensions we need, and the optional ones we have
+			std::vector<const char*> enabledExtensions = extensions;
+			if (supportInfo.memoryBudgetSupported) {
+				enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+			}
+			createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+			createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 			createInfo.enabledLayerCount = 0;
 
@@ -217,6 +303,12 @@ namespace vku {
 
 			vkGetDeviceQueue(this->handle, supportInfo.graphicsFamily.value(), 0, &this->graphicsQueue);
 			vkGetDeviceQueue(this->handle, supportInfo.presentFamily.value(), 0, &this->presentQueue);
+			if (supportInfo.transferFamily.has_value()) {
+				vkGetDeviceQueue(this->handle, supportInfo.transferFamily.value(), 0, &this->transferQueue);
+			}
+			else {
+				this->transferQueue = this->graphicsQueue;
+			}
 		}
 
 		// create command pool
@@ -228,31 +320,58 @@ namespace vku {
 			vkCreateCommandPool(this->handle, &commandPoolCI, nullptr, &this->commandPool);
 		}
 
-		// create descriptor pool
-		{
-			VkDescriptorPoolCreateInfo descriptorPoolCI{};
-			descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-			descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(info.descriptorPoolSizes.size());
-			descriptorPoolCI.pPoolSizes = info.descriptorPoolSizes.data();
-			descriptorPoolCI.maxSets = info.maxDescriptorSets;
-			descriptorPoolCI.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-			vkCreateDescriptorPool(this->handle, &descriptorPoolCI, nullptr, &this->descriptorPool);
+		this->memoryAllocator = new MemoryAllocator(this, info.memoryBlockSize, info.memoryBudgetWarning, info.deviceLocalBudget);
+		this->uploadManager = new UploadManager(this, info.uploadStagingSize);
+
+		// descriptor sets come from pool chains that grow on demand
+		this->descriptorAllocator = new DescriptorAllocator(this, info.descriptorPoolSizes, info.descriptorSetsPerPool);
+		this->deletionQueue = new DeletionQueue();
+		this->geometryBuffer = new GeometryBuffer(this, info.geometryArenaVertices, info.geometryArenaIndices);
+		this->descriptorLayoutCache = new DescriptorLayoutCache(this);
+
+		if (supportInfo.bindlessSupported) {
+			const VkPhysicalDeviceDescriptorIndexingProperties& limits = supportInfo.descriptorIndexingProperties;
+			uint32_t capacity = std::min({ info.bindlessTextureCapacity, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+			this->bindlessTextures = new BindlessTextureTable(this, capacity);
 		}
 
+		// load pipeline cache from the previous run, if it is still valid
+		this->pipelineCache = new VulkanPipelineCache(this, info.pipelineCachePath);
+		this->pipelineRegistry = new PipelineRegistry(this);
+		this->pipelineCompiler = new PipelineCompiler(this, info.pipelineCompilerThreads);
+		this->pipelineUsageLog = new PipelineUsageLog(info.pipelineUsageLogPath);
+
 		// create swapchain
 		this->swapchain = new VulkanSwapchain(this);
+		this->uniformRing = new UniformRing(this, info.uniformRingFrameSize, swapchain->swapChainLength);
 
 		// create runtime shader cache
 		this->shaderCache = new ShaderCache(this);
 
+		this->samplerCache = new SamplerCache(this);
 		this->textureCommons = new TextureCommons(this);
 	}
 
 	VulkanDevice::~VulkanDevice() {
+		// joins the workers first, since their builds use the shader cache
+		delete pipelineCompiler;
 		delete textureCommons;
 		delete shaderCache;
 		delete swapchain;
-		vkDestroyDescriptorPool(handle, descriptorPool, nullptr);
+		delete pipelineUsageLog;
+		delete pipelineRegistry;
+		// everything retired above is destroyed here
+		delete deletionQueue;
+		// released reservations go back to the ring from the queue
+		delete uniformRing;
+		delete geometryBuffer;
+		delete samplerCache;
+		delete descriptorLayoutCache;
+		delete pipelineCache;
+		delete bindlessTextures;
+		delete descriptorAllocator;
+		delete uploadManager;
+		delete memoryAllocator;
 		vkDestroyCommandPool(handle, commandPool, nullptr);
 		vkDestroyDevice(handle, nullptr);
 	}
@@ -291,6 +410,9 @@ namespace vku {
 	void VulkanDevice::submitCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue) {
 		vkEndCommandBuffer(commandBuffer);
 
+		// one-shot work may read anything uploaded so far
+		uploadManager->finish();
+
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 		submitInfo.commandBufferCount = 1;
@@ -314,7 +436,7 @@ namespace vku {
 
 		submitCommandBuffer(commandBuffer, graphicsQueue);
 	}
-	void VulkanDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+	void VulkanDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& allocation, MemoryCategory category) {
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
@@ -325,22 +447,26 @@ namespace vku {
 			throw std::runtime_error("Failed to create vertex buffer!");
 		}
 
-		// find memory type index that is suitable
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(*this, buffer, &memRequirements);
+		allocation = memoryAllocator->allocate(buffer, properties, category);
+	}
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findSupportedMemoryType(memRequirements.memoryTypeBits, properties);
+	void VulkanDevice::createStagingBuffer(VkDeviceSize size, VkBuffer& buffer, MemoryAllocation& allocation) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-		// allocate the memory
-		if (vkAllocateMemory(*this, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate vertex buffer memory!");
+		if (vkCreateBuffer(*this, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create staging buffer!");
 		}
 
-		// copy vertex data to newly allocated buffer
-		vkBindBufferMemory(*this, buffer, bufferMemory, 0);
+		allocation = memoryAllocator->allocate(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, true);
+	}
+
+	void VulkanDevice::destroyBuffer(VkBuffer buffer, MemoryAllocation& allocation) {
+		vkDestroyBuffer(*this, buffer, nullptr);
+		memoryAllocator->free(allocation);
 	}
 
 	uint32_t VulkanDevice::findSupportedMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -1,26 +1,55 @@
 #pragma once
 
 #include <optional>
+#include <string>
 #include <vector>
 
 #include <vulkan/vulkan_core.h>
 #include <vulkan/vulkan_beta.h>
 
+#include "memory/MemoryAllocator.h"
+#include "memory/GeometryBuffer.h"
+#include "UploadManager.h"
+
 namespace vku {
 	struct VulkanContext;
 	struct VulkanSwapchain;
 	struct ShaderCache;
 	struct TextureCommons;
+	struct SamplerCache;
+	struct UniformRing;
+	struct VulkanPipelineCache;
+	struct PipelineRegistry;
+	struct PipelineCompiler;
+	struct PipelineUsageLog;
+	struct DeletionQueue;
+	struct DescriptorAllocator;
+	struct BindlessTextureTable;
+	struct DescriptorLayoutCache;
 
 	struct DeviceSupportInformation {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		// a family that can only transfer, which usually maps to the GPU's copy engines. not every GPU has one.
+		std::optional<uint32_t> transferFamily;
 
 		VkPhysicalDeviceProperties deviceProperties;
 		VkPhysicalDeviceFeatures deviceFeatures;
 		VkAccelerationStructureCreateInfoKHR* p;
 		VkPhysicalDeviceRayTracingFeaturesKHR rtFeatures;
 		VkPhysicalDeviceRayTracingPropertiesKHR rtProps;
+		VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures;
+		VkPhysicalDeviceDescriptorIndexingProperties descriptorIndexingProperties;
+		// the device reports Vulkan 1.2, so its 1.2 features can be queried and enabled at all
+		bool vulkan12Supported;
+		// upload batches signal a timeline semaphore that frames wait on, so the engine can't run without them
+		bool timelineSemaphoreSupported;
+		// everything the bindless texture table needs from descriptor indexing
+		bool bindlessSupported;
+		// indirect draws with a GPU written count and first instance, for GpuCulling
+		bool gpuDrivenSupported;
+		// VK_EXT_memory_budget, which the memory allocator checks its heaps against
+		bool memoryBudgetSupported;
 
 		VkSampleCountFlags maxSampleCount;
 	};
@@ -33,12 +62,39 @@ namespace vku {
 
 	struct VulkanDeviceInfo {
 		VulkanContext* context;
+		// descriptors of each type to reserve per set. descriptor pools are sized by multiplying these with their set count.
 		std::vector<VkDescriptorPoolSize> descriptorPoolSizes = {
-			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000},
-			{VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000},
-			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000}
+			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 8},
+			{VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 4},
+			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4},
+			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
+			{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1}
 		};
-		uint32_t maxDescriptorSets = 1000;
+		// sets in the first descriptor pool. each further pool doubles it, so there is no upper limit.
+		uint32_t descriptorSetsPerPool = 64;
+		// slots in the bindless texture table, if the device supports it. clamped to the device limits.
+		uint32_t bindlessTextureCapacity = 4096;
+		// size of the device memory blocks buffers and images are sub-allocated from
+		VkDeviceSize memoryBlockSize = 64 * 1024 * 1024;
+		// share of a heap's budget past which new memory blocks print a warning
+		float memoryBudgetWarning = 0.9f;
+		// caps the budget of device local heaps, to see how a scene fits on a smaller GPU. 0 leaves it to the driver.
+		VkDeviceSize deviceLocalBudget = 0;
+		// bytes of the upload manager's staging ring. bigger uploads get a staging buffer of their own.
+		VkDeviceSize uploadStagingSize = 32 * 1024 * 1024;
+		// vertices and indices per arena of the geometry buffer, which all meshes are packed into
+		uint32_t geometryArenaVertices = 512 * 1024;
+		uint32_t geometryArenaIndices = 2 * 1024 * 1024;
+		// bytes of the uniform ring per swapchain image
+		VkDeviceSize uniformRingFrameSize = 64 * 1024;
+
+		// where the pipeline cache is persisted between runs. empty disables persistence.
+		std::string pipelineCachePath = "pipeline_cache.bin";
+		// where material pipelines used this run are recorded, so the next run can build them up front. empty disables it.
+		std::string pipelineUsageLogPath = "pipeline_usage.json";
+		// threads building pipelines in the background. 0 picks one less than the hardware threads.
+		uint32_t pipelineCompilerThreads = 0;
 	};
 
 	struct VulkanDevice {
@@ -51,13 +107,39 @@ namespace vku {
 		VkDevice handle;
 		VkQueue graphicsQueue;
 		VkQueue presentQueue;
+		// the transfer family's queue if there is one, otherwise the graphics queue
+		VkQueue transferQueue;
 
 		VkCommandPool commandPool;
-		VkDescriptorPool descriptorPool;
+		// device memory for every buffer and image
+		MemoryAllocator* memoryAllocator;
+		// batched buffer and image uploads
+		UploadManager* uploadManager;
+		DescriptorAllocator* descriptorAllocator;
+		// shared descriptor set layouts and pipeline layouts
+		DescriptorLayoutCache* descriptorLayoutCache;
+		// nullptr if the device lacks descriptor indexing
+		BindlessTextureTable* bindlessTextures = nullptr;
 
 		VulkanSwapchain* swapchain;
-
+		// per-frame uniform data, bound with dynamic offsets
+		UniformRing* uniformRing;
+
+		// retires objects that frames in flight may still use, instead of waiting for the device to idle
+		DeletionQueue* deletionQueue;
+		// shared vertex and index buffers that meshes are sub-allocated from
+		GeometryBuffer* geometryBuffer;
+
+		VulkanPipelineCache* pipelineCache;
+		PipelineRegistry* pipelineRegistry;
+		PipelineCompiler* pipelineCompiler;
+		PipelineUsageLog* pipelineUsageLog;
+		// bumped on the render thread whenever a material switches to another VkPipeline.
+		// command buffers recorded before that may still point at the retired one.
+		uint64_t pipelineGeneration = 0;
 		ShaderCache* shaderCache;
+		// shared samplers, deduplicated by VulkanSamplerInfo
+		SamplerCache* samplerCache;
 		TextureCommons* textureCommons;
 
 		VulkanDevice(VulkanDeviceInfo info);
@@ -72,36 +154,25 @@ namespace vku {
 		void submitCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue);
 
 		void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		// the memory comes from the memoryAllocator, and is mapped if it is host visible
+		void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& allocation, MemoryCategory category = MemoryCategory::Other);
+		// a mapped transfer source from the allocator's transient path. destroy it as soon as the copy is done.
+		void createStagingBuffer(VkDeviceSize size, VkBuffer& buffer, MemoryAllocation& allocation);
+		void destroyBuffer(VkBuffer buffer, MemoryAllocation& allocation);
 
+		// the contents arrive through the uploadManager, before the next frame or one-shot command buffer runs
 		template <typename Type>
-		void initDeviceLocalBuffer(const std::vector<Type>& bufferData, VkBuffer& buffer, VkDeviceMemory& deviceMemory, VkBufferUsageFlagBits bufferUsageBit) {
+		void initDeviceLocalBuffer(const std::vector<Type>& bufferData, VkBuffer& buffer, MemoryAllocation& allocation, VkBufferUsageFlagBits bufferUsageBit, MemoryCategory category = MemoryCategory::Other) {
 			VkDeviceSize bufferSize = sizeof(bufferData[0]) * bufferData.size();
 
-			VkBuffer stagingBuffer;
-			VkDeviceMemory stagingBufferMemory;
-			createBuffer(bufferSize,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				stagingBuffer,
-				stagingBufferMemory);
-
-			void* data;
-			vkMapMemory(*this, stagingBufferMemory, 0, bufferSize, 0, &data);
-			memcpy(data, bufferData.data(), (size_t)bufferSize);
-			vkUnmapMemory(*this, stagingBufferMemory);
-
 			createBuffer(bufferSize,
 				VK_BUFFER_USAGE_TRANSFER_DST_BIT | bufferUsageBit,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				buffer,
-				deviceMemory);
-
-			// copy staging buffer to vertex buffer
-			copyBuffer(stagingBuffer, buffer, bufferSize);
+				allocation,
+				category);
 
-			vkDestroyBuffer(*this, stagingBuffer, nullptr);
-			vkFreeMemory(*this, stagingBufferMemory, nullptr);
+			uploadManager->uploadBuffer(buffer, 0, bufferData.data(), bufferSize);
 		}
 
 		uint32_t findSupportedMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <string>
+#include <iostream>
 
 #include <vulkan/vulkan.h>
 #include <spirv_cross/spirv_glsl.hpp>
@@ -10,12 +11,19 @@
 #include "rendergraph/RenderGraph.h"
 
 #include "VulkanDevice.h"
+#include "VulkanPipelineCache.h"
 #include "VulkanSwapchain.h"
 #include "VulkanDescriptorSet.h"
 #include "shader/ShaderModule.h"
 #include "shader/ShaderVariant.h"
 #include "VulkanTexture.h"
 #include "VulkanMesh.h"
+#include "CommandRecorder.h"
+#include "pipeline/PipelineRegistry.h"
+#include "pipeline/PipelineCompiler.h"
+#include "pipeline/PipelineUsageLog.h"
+#include "descriptor/BindlessTextureTable.h"
+#include "descriptor/DescriptorLayoutCache.h"
 
 namespace vku {
 	VulkanMaterialInfo::VulkanMaterialInfo() {
@@ -127,96 +135,174 @@ namespace vku {
 		pipeline.pDynamicState = &dynamicState;
 	}
 
-	VulkanMaterial::VulkanMaterial(VulkanMaterialInfo* const matInfo, Scene* const scene, Pass* const pass) {
+	// use reflection to enumerate the material descriptors (set 2) the shaders expect
+	static std::vector<DescriptorLayout> reflectMaterialDescriptors(const std::vector<ShaderModule*>& shaderModules) {
+		std::vector<DescriptorLayout> reflDescriptors;
+
+		for (ShaderModule* sModule : shaderModules) {
+			// convert from char vector to uint32_t vector, then reflect
+			std::vector<uint32_t> spv = sModule->spirvData;
+			spirv_cross::CompilerGLSL glsl(std::move(spv));
+			spirv_cross::ShaderResources resources = glsl.get_shader_resources();
+
+			for (auto& resource : resources.uniform_buffers) {
+				unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
+				if (set == 2) {
+					unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
+					if (reflDescriptors.size() <= binding) { reflDescriptors.resize(binding + 1); }
+					reflDescriptors[binding] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS };
+				}
+			}
+
+			for (auto& resource : resources.storage_buffers) {
+				unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
+				if (set == 2) {
+					unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
+					if (reflDescriptors.size() <= binding) { reflDescriptors.resize(binding + 1); }
+					reflDescriptors[binding] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS };
+				}
+			}
+
+			for (auto& resource : resources.sampled_images)
+			{
+				unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
+				if (set == 2) {
+					unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
+					const spirv_cross::SPIRType type = glsl.get_type(resource.base_type_id);
+
+					if (reflDescriptors.size() <= binding) { reflDescriptors.resize(binding + 1); }
+					reflDescriptors[binding] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS };
+				}
+			}
+		}
+
+		return reflDescriptors;
+	}
+
+	VulkanMaterial::VulkanMaterial(VulkanMaterialInfo* const matInfo, Scene* const scene, Pass* const pass, bool async) {
 		this->scene = scene;
 		this->pass = pass;
 
 		this->info = new VulkanMaterialInfo(*matInfo);
 		this->info->linkPointers();
 
-		init();
+		// so the next session can build this pipeline during start-up
+		scene->device->pipelineUsageLog->record(pass->schema->name, *info);
+
+		if (!async) {
+			init();
+			return;
+		}
+
+		// shaders are loaded on the compiler thread. if the layout isn't given up front, it comes with the pipeline,
+		// and the first instance has to wait for the build.
+		if (!info->descriptorLayouts.empty()) {
+			ownedLayout = scene->device->descriptorLayoutCache->acquireSetLayout(info->descriptorLayouts);
+			descriptorSetLayout = ownedLayout;
+		}
+
+		scene->device->pipelineCompiler->submit(this);
 	}
 
-	void VulkanMaterial::rebuild() {
-		destroy();
-		init();
+	void VulkanMaterial::rebuild(bool synchronous) {
+		// the material keeps drawing with its current pipeline until the compiler publishes the new one
+		if (!synchronous) {
+			scene->device->pipelineCompiler->submit(this);
+			return;
+		}
+
+		// a pending asynchronous build would be stale
+		scene->device->pipelineCompiler->cancel(this);
+		try {
+			use(build(*scene->device->pipelineCache));
+		}
+		catch (const std::runtime_error& e) {
+			// keep drawing with the old pipeline
+			std::cerr << e.what() << std::endl;
+		}
 	}
 
 	void VulkanMaterial::init() {
-		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+		use(build(*scene->device->pipelineCache));
+	}
+
+	std::vector<ShaderModule*> VulkanMaterial::loadShaderModules() {
+		ShaderCache* shaderCache = scene->device->shaderCache;
 		std::vector<ShaderModule*> shaderModules;
-		std::vector<DescriptorLayout> reflDescriptors;
+		try {
+			for (const ShaderVariant& info : info->shaderStages) {
+				// compiles the shader if needed, and registers the callback to rebuild if it recompiles
+				shaderModules.push_back(shaderCache->acquireForBuild(info, { [this]() {
+					rebuild();
+				}, (size_t)this }));
+			}
+		}
+		catch (...) {
+			releaseShaderModules(shaderModules);
+			throw;
+		}
+		return shaderModules;
+	}
+
+	void VulkanMaterial::releaseShaderModules(const std::vector<ShaderModule*>& shaderModules) {
+		for (ShaderModule* sModule : shaderModules) {
+			scene->device->shaderCache->releaseFromBuild(sModule);
+		}
+	}
+
+	SharedPipeline* VulkanMaterial::build(VkPipelineCache cache) {
+		// a reload can't retire these modules until the pipeline has been created from them
+		std::vector<ShaderModule*> shaderModules = loadShaderModules();
+		try {
+			SharedPipeline* built = createPipeline(cache, shaderModules);
+			releaseShaderModules(shaderModules);
+			return built;
+		}
+		catch (...) {
+			releaseShaderModules(shaderModules);
+			throw;
+		}
+	}
+
+	SharedPipeline* VulkanMaterial::createPipeline(VkPipelineCache cache, const std::vector<ShaderModule*>& shaderModules) {
+		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
 		info->pipeline.subpass = 0;
 		info->pipeline.renderPass = pass->pass;
 		info->multisampling.rasterizationSamples = pass->schema->samples;
 
-		// load shaders into the pipeline state, and analyze shader for expected descriptors
-		for (const ShaderVariant& info : info->shaderStages) {
-			// now compile the actual shader
-			ShaderModule* sModule = this->scene->device->shaderCache->get(info);
-			// register callback to rebuild if the shader recompiles
-			sModule->registerHotReloadCallback({ [this]() {
-				rebuild();
-			}, (size_t)this });
-			VkPipelineShaderStageCreateInfo stage = sModule->getStageInfo();
-			shaderModules.push_back(sModule);
-			shaderStages.push_back(stage);
-
-			// use reflection to enumerate the inputs of this shader
-			{
-				// convert from char vector to uint32_t vector, then reflect
-				std::vector<uint32_t> spv = sModule->spirvData;
-				spirv_cross::CompilerGLSL glsl(std::move(spv));
-				spirv_cross::ShaderResources resources = glsl.get_shader_resources();
-
-				for (auto& resource : resources.uniform_buffers) {
-					unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
-					if (set == 2) {
-						unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
-						if (reflDescriptors.size() <= binding) { reflDescriptors.resize(binding + 1); }
-						reflDescriptors[binding] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS };
-					}
-				}
+		// load shaders into the pipeline state
 
-				for (auto& resource : resources.sampled_images)
-				{
-					unsigned set = glsl.get_decoration(resource.id, spv::DecorationDescriptorSet);
-					if (set == 2) {
-						unsigned binding = glsl.get_decoration(resource.id, spv::DecorationBinding);
-						const spirv_cross::SPIRType type = glsl.get_type(resource.base_type_id);
+		// resolve specialization constants by name. the arrays have to live until the pipeline is created.
+		std::vector<std::vector<VkSpecializationMapEntry>> specEntries(shaderModules.size());
+		std::vector<std::vector<uint32_t>> specData(shaderModules.size());
+		std::vector<VkSpecializationInfo> specInfos(shaderModules.size());
+		for (size_t i = 0; i < shaderModules.size(); i++) {
+			ShaderModule* sModule = shaderModules[i];
+			VkPipelineShaderStageCreateInfo stageInfo = sModule->getStageInfo();
 
-						if (reflDescriptors.size() <= binding) { reflDescriptors.resize(binding + 1); }
-						reflDescriptors[binding] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS };
-					}
+			for (auto& [name, value] : info->shaderStages[i].constants) {
+				auto id = sModule->specializationConstantIds.find(name);
+				if (id == sModule->specializationConstantIds.end()) {
+					throw std::runtime_error("Shader '" + sModule->info.name + "' has no specialization constant '" + name + "'!");
 				}
+				uint32_t offset = static_cast<uint32_t>(specData[i].size() * sizeof(uint32_t));
+				specEntries[i].push_back({ id->second, offset, sizeof(uint32_t) });
+				specData[i].push_back(value.bits);
 			}
+
+			if (!specEntries[i].empty()) {
+				specInfos[i].mapEntryCount = static_cast<uint32_t>(specEntries[i].size());
+				specInfos[i].pMapEntries = specEntries[i].data();
+				specInfos[i].dataSize = specData[i].size() * sizeof(uint32_t);
+				specInfos[i].pData = specData[i].data();
+				stageInfo.pSpecializationInfo = &specInfos[i];
+			}
+			shaderStages.push_back(stageInfo);
 		}
 		info->pipeline.stageCount = static_cast<uint32_t>(shaderStages.size());
 		info->pipeline.pStages = shaderStages.data();
 
-		// create descriptor layout (expand later)
-		descriptorSetLayout = new VulkanDescriptorSetLayout(scene->device, reflDescriptors);
-
-		// create pipeline layout to aggregate all descriptor sets
-		std::vector<VkDescriptorSetLayout> dSetLayouts{
-			scene->globalDescriptorSetLayout->handle,
-			pass->inputLayout->handle,
-			this->descriptorSetLayout->handle
-		};
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(dSetLayouts.size());
-		pipelineLayoutInfo.pSetLayouts = dSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(info->pushConstRanges.size());
-		pipelineLayoutInfo.pPushConstantRanges = info->pushConstRanges.data();
-
-		VkResult result = vkCreatePipelineLayout(*scene->device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
-		if (result != VK_SUCCESS) {
-			throw std::runtime_error("Failed to create pipeline layout for material!");
-		}
-
 		// generate color attachment blending states if not specified
 		if (info->colorBlendAttachments.size() == 0) {
 			for (AttachmentSchema* attachment : pass->schema->out) {
@@ -239,29 +325,134 @@ namespace vku {
 		info->colorBlending.attachmentCount = info->colorBlendAttachments.size();
 		info->colorBlending.pAttachments = info->colorBlendAttachments.data();
 
-		info->pipeline.layout = pipelineLayout;
-		vkCreateGraphicsPipelines(*scene->device, VK_NULL_HANDLE, 1, &info->pipeline, nullptr, &pipeline);
+		std::vector<DescriptorLayout> materialDescriptors = info->descriptorLayouts;
+		if (materialDescriptors.empty()) {
+			materialDescriptors = reflectMaterialDescriptors(shaderModules);
+		}
+
+		// descriptor set layouts owned by the scene and pass, which come before the material's own set
+		std::vector<VkDescriptorSetLayout> dSetLayouts{
+			scene->globalDescriptorSetLayout->handle,
+			pass->inputLayout->handle
+		};
+		// the device texture table follows the material set
+		if (info->bindless) {
+			if (scene->device->bindlessTextures == nullptr) {
+				throw std::runtime_error("Bindless materials need a device with descriptor indexing!");
+			}
+			dSetLayouts.push_back(scene->device->bindlessTextures->layout);
+		}
+
+		// materials with identical state share a single pipeline
+		PipelineRegistry* registry = scene->device->pipelineRegistry;
+		PipelineKey key = pipelineStateKey(*info, shaderModules, dSetLayouts, materialDescriptors);
+		SharedPipeline* existing = registry->acquire(key);
+		if (existing != nullptr) {
+			return existing;
+		}
+		// from here on, anyone else asking for this key waits until we insert or abandon it
+
+		// layouts are shared through the device cache, so materials with the same bindings get the same handles
+		DescriptorLayoutCache* layoutCache = scene->device->descriptorLayoutCache;
+		VulkanDescriptorSetLayout* materialLayout;
+		try {
+			materialLayout = layoutCache->acquireSetLayout(materialDescriptors);
+		}
+		catch (const std::runtime_error& e) {
+			registry->abandon(key);
+			throw;
+		}
+		dSetLayouts.insert(dSetLayouts.begin() + 2, materialLayout->handle);
+
+		VkPipelineLayout newPipelineLayout;
+		try {
+			newPipelineLayout = layoutCache->acquirePipelineLayout(dSetLayouts, info->pushConstRanges);
+		}
+		catch (const std::runtime_error& e) {
+			layoutCache->releaseSetLayout(materialLayout);
+			registry->abandon(key);
+			throw;
+		}
+
+		VkGraphicsPipelineCreateInfo pipelineCI = info->pipeline;
+		pipelineCI.layout = newPipelineLayout;
+		VkPipeline newPipeline;
+		if (vkCreateGraphicsPipelines(*scene->device, cache, 1, &pipelineCI, nullptr, &newPipeline) != VK_SUCCESS) {
+			layoutCache->releasePipelineLayout(newPipelineLayout);
+			layoutCache->releaseSetLayout(materialLayout);
+			registry->abandon(key);
+			throw std::runtime_error("Failed to create graphics pipeline for material!");
+		}
+
+		return registry->insert(key, newPipeline, newPipelineLayout, materialLayout);
+	}
+
+	void VulkanMaterial::use(SharedPipeline* shared) {
+		SharedPipeline* previous = this->shared;
+		if (previous != nullptr && previous->descriptorSetLayout != shared->descriptorSetLayout) {
+			std::cerr << "Material descriptors changed on reload; existing instances may be incompatible until restart." << std::endl;
+		}
+
+		this->shared = shared;
+		info->pipeline.layout = shared->pipelineLayout;
+		pipeline = shared->pipeline;
+		pipelineLayout = shared->pipelineLayout;
+		// sets of existing instances were allocated from our own layout, which is compatible with the shared one
+		descriptorSetLayout = ownedLayout != nullptr ? ownedLayout : shared->descriptorSetLayout;
+		ready = true;
+		scene->device->pipelineGeneration++;
+
+		// the new pipeline holds on to the layout, so only the VkPipeline is replaced. frames in flight keep the old one alive.
+		if (previous != nullptr) {
+			scene->device->pipelineRegistry->release(previous);
+		}
 	}
 
 	void VulkanMaterial::destroy() {
-		vkDestroyDescriptorSetLayout(*scene->device, *descriptorSetLayout, nullptr);
-		vkDestroyPipelineLayout(*scene->device, pipelineLayout, nullptr);
-		vkDestroyPipeline(*scene->device, pipeline, nullptr);
+		if (shared != nullptr) {
+			scene->device->pipelineRegistry->release(shared);
+		}
+		shared = nullptr;
+		pipeline = VK_NULL_HANDLE;
+		pipelineLayout = VK_NULL_HANDLE;
+		ready = false;
 	}
 
 	void VulkanMaterial::bind(VkCommandBuffer cb) {
 		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		if (info->bindless) {
+			scene->device->bindlessTextures->bind(cb, pipelineLayout);
+		}
+	}
+
+	void VulkanMaterial::bind(CommandRecorder& recorder) {
+		recorder.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		if (info->bindless) {
+			scene->device->bindlessTextures->bind(recorder, pipelineLayout);
+		}
 	}
 
 	VulkanMaterial::~VulkanMaterial() {
+		scene->device->shaderCache->unregisterHotReloadCallbacks((size_t)this);
+		scene->device->pipelineCompiler->cancel(this);
 		destroy();
+		// instance sets may still be in flight, so the cache retires it through the deletion queue
+		if (ownedLayout != nullptr) {
+			scene->device->descriptorLayoutCache->releaseSetLayout(ownedLayout);
+		}
 	}
 
 
-	VulkanMaterialInstance::VulkanMaterialInstance(VulkanMaterial* mat) {
+	VulkanMaterialInstance::VulkanMaterialInstance(VulkanMaterial* mat, std::vector<uint32_t> frameVaryingBindings) {
 		this->material = mat;
+		this->frameVaryingBindings = frameVaryingBindings;
 
-		descriptorSets.resize(mat->scene->device->swapchain->swapChainLength);
+		// an asynchronous material without descriptorLayouts only knows its layout once it is built
+		if (mat->descriptorSetLayout == nullptr) {
+			mat->scene->device->pipelineCompiler->finish(mat);
+		}
+
+		descriptorSets.resize(frameVaryingBindings.empty() ? 1 : mat->scene->device->swapchain->swapChainLength);
 		for (uint32_t i = 0; i < descriptorSets.size(); i++) {
 			descriptorSets[i] = new VulkanDescriptorSet(material->descriptorSetLayout);
 		}
@@ -274,6 +465,26 @@ namespace vku {
 	}
 
 	void VulkanMaterialInstance::bind(VkCommandBuffer cb, uint32_t i) {
-		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &descriptorSets[i]->handle, 0, nullptr);
+		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &descriptorSet(i)->handle, 0, nullptr);
+	}
+
+	void VulkanMaterialInstance::bind(CommandRecorder& recorder, uint32_t i) {
+		recorder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &descriptorSet(i)->handle);
+	}
+
+	VulkanDescriptorSet* VulkanMaterialInstance::descriptorSet(uint32_t i) {
+		return descriptorSets.size() == 1 ? descriptorSets[0] : descriptorSets[i];
+	}
+
+	VulkanMaterialInstance* VulkanMaterialInstance::resolve() {
+		if (material->ready) {
+			return this;
+		}
+
+		VulkanMaterialInstance* fallback = material->pass->fallbackMaterial;
+		if (fallback != nullptr && fallback->material->ready) {
+			return fallback;
+		}
+		return nullptr;
 	}
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <vulkan/vulkan.h>
 
 #include "shader/ShaderCache.h"
+#include "shader/ShaderVariant.h"
 #include "VulkanDescriptorSet.h"
 
 namespace vku {
@@ -15,6 +16,9 @@ namespace vku {
 	struct VulkanDescriptorSet;
 	struct VulkanDescriptorSetLayout;
 	struct Pass;
+	struct SharedPipeline;
+	struct ShaderModule;
+	struct CommandRecorder;
 
 	struct VulkanMaterialInfo {
 		VkGraphicsPipelineCreateInfo pipeline{};
@@ -41,6 +45,13 @@ namespace vku {
 		std::vector<VkPushConstantRange> pushConstRanges{};
 		std::vector<ShaderVariant> shaderStages;
 
+		// layout of the material descriptor set (set 2). reflected from the shaders if left empty.
+		// asynchronously built materials should have it up front, or their first instance waits for the build.
+		std::vector<DescriptorLayout> descriptorLayouts;
+
+		// the pipeline layout gets the device's bindless texture table as set 3, and bind() binds it
+		bool bindless = false;
+
 		VulkanMaterialInfo();
 
 		// link pointers inside structs to reference each other
@@ -54,32 +65,68 @@ namespace vku {
 		Scene* scene;
 		Pass* pass;
 
-		VkPipeline pipeline;
-		VkPipelineLayout pipelineLayout;
+		// handles borrowed from the shared pipeline, which may be used by other identical materials
+		SharedPipeline* shared = nullptr;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 
-		VulkanDescriptorSetLayout* descriptorSetLayout;
+		VulkanDescriptorSetLayout* descriptorSetLayout = nullptr;
 
-		VulkanMaterial(VulkanMaterialInfo* const matInfo, Scene* const scene, Pass* const pass);
+		// false until the pipeline exists. asynchronous materials become ready at a frame boundary.
+		bool ready = false;
 
-		void rebuild();
+		// with async, the pipeline is built on the device's PipelineCompiler thread and the constructor returns immediately
+		VulkanMaterial(VulkanMaterialInfo* const matInfo, Scene* const scene, Pass* const pass, bool async = false);
+
+		// builds the pipeline again on the compiler threads, eg. after a shader reload. synchronous builds it on the
+		// calling thread right away, which stalls it for the whole pipeline compile.
+		void rebuild(bool synchronous = false);
 		void bind(VkCommandBuffer cb);
+		void bind(CommandRecorder& recorder);
 
 		~VulkanMaterial();
 
 	private:
+		friend struct PipelineCompiler;
+
+		// created up front for asynchronous materials, so instances can be allocated before the pipeline exists
+		VulkanDescriptorSetLayout* ownedLayout = nullptr;
+
 		void init();
 		void destroy();
+
+		// the current modules of every stage, held until they are given back with releaseShaderModules
+		std::vector<ShaderModule*> loadShaderModules();
+		void releaseShaderModules(const std::vector<ShaderModule*>& shaderModules);
+		// safe to call off the render thread, with a pipeline cache only that thread uses
+		SharedPipeline* build(VkPipelineCache cache);
+		SharedPipeline* createPipeline(VkPipelineCache cache, const std::vector<ShaderModule*>& shaderModules);
+		void use(SharedPipeline* shared);
 	};
 
 	struct VulkanMaterialInstance {
 		VulkanMaterial* material;
 
+		// bindings of set 2 that point at different resources for each swapchain image
+		std::vector<uint32_t> frameVaryingBindings;
+		// a single set shared by every swapchain image, unless some bindings vary per frame.
+		// writes that are the same for every image go to each set in here.
 		std::vector<VulkanDescriptorSet*> descriptorSets;
 
-		VulkanMaterialInstance(VulkanMaterial* mat);
+		// most instances only point at textures and buffers that stay put, and get away with one set.
+		// only list bindings whose resource is different per swapchain image.
+		VulkanMaterialInstance(VulkanMaterial* mat, std::vector<uint32_t> frameVaryingBindings = {});
 
 		~VulkanMaterialInstance();
 
 		void bind(VkCommandBuffer cb, uint32_t i);
+		void bind(CommandRecorder& recorder, uint32_t i);
+
+		// the set swapchain image i binds
+		VulkanDescriptorSet* descriptorSet(uint32_t i);
+
+		// the instance to draw with: this one once its pipeline is ready, otherwise the pass fallback.
+		// returns nullptr if the draw should be skipped.
+		VulkanMaterialInstance* resolve();
 	};
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <vulkan/vulkan.h>
 
 #include "VulkanDevice.h"
+#include "CommandRecorder.h"
 
 namespace vku {
 	VkVertexInputBindingDescription Vertex::getBindingDescription() {
@@ -73,21 +74,29 @@ namespace vku {
 
 	VulkanMeshBuffer::VulkanMeshBuffer(VulkanDevice* device, const VulkanMeshData& mesh) {
 		this->device = device;
-		device->initDeviceLocalBuffer<uint32_t>(mesh.indices, iBuffer, iMemory, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-		device->initDeviceLocalBuffer<Vertex>(mesh.vertices, vBuffer, vMemory, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		geometry = device->geometryBuffer->allocate(mesh);
 		indicesSize = mesh.indices.size();
 	}
 	void VulkanMeshBuffer::draw(VkCommandBuffer cmdbuf) {
+		if (indicesSize == 0) {
+			return;
+		}
 		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(cmdbuf, 0, 1, &vBuffer, offsets);
-		vkCmdBindIndexBuffer(cmdbuf, iBuffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(cmdbuf, indicesSize, 1, 0, 0, 0);
+		vkCmdBindVertexBuffers(cmdbuf, 0, 1, &geometry.vertexBuffer, offsets);
+		vkCmdBindIndexBuffer(cmdbuf, geometry.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(cmdbuf, indicesSize, 1, geometry.firstIndex, geometry.vertexOffset, 0);
+	}
+	void VulkanMeshBuffer::draw(CommandRecorder& recorder) {
+		if (indicesSize == 0) {
+			return;
+		}
+		// meshes in the same arena keep the buffers bound
+		recorder.bindVertexBuffer(geometry.vertexBuffer);
+		recorder.bindIndexBuffer(geometry.indexBuffer);
+		recorder.drawIndexed(indicesSize, 1, geometry.firstIndex, geometry.vertexOffset, 0);
 	}
 	VulkanMeshBuffer::~VulkanMeshBuffer() {
-		vkDestroyBuffer(*device, vBuffer, nullptr);
-		vkDestroyBuffer(*device, iBuffer, nullptr);
-		vkFreeMemory(*device, vMemory, nullptr);
-		vkFreeMemory(*device, iMemory, nullptr);
+		device->geometryBuffer->free(geometry);
 	}
 
 	void MikktCalculator::generateTangentSpace(VulkanMeshData* model) {
@@ -9,8 +9,11 @@
 #include <mikktspace.h>
 #include <vulkan/vulkan.h>
 
+#include "memory/GeometryBuffer.h"
+
 namespace vku {
 	struct VulkanDevice;
+	struct CommandRecorder;
 
 	struct Vertex {
 		glm::vec3 pos;
@@ -30,17 +33,16 @@ namespace vku {
 		void serializeToCpp();
 	};
 
+	// a mesh in the device's GeometryBuffer. meshes in the same arena share their vertex and index buffers.
 	struct VulkanMeshBuffer {
 		VulkanDevice* device;
 
-		VkBuffer vBuffer;
-		VkDeviceMemory vMemory;
-		VkBuffer iBuffer;
-		VkDeviceMemory iMemory;
+		GeometryAllocation geometry;
 		uint32_t indicesSize;
 
 		VulkanMeshBuffer(VulkanDevice* device, const VulkanMeshData& mesh);
 		void draw(VkCommandBuffer cmdbuf);
+		void draw(CommandRecorder& recorder);
 		~VulkanMeshBuffer();
 	};
 	const VulkanMeshData sphere = {
@@ -0,0 +1,152 @@
+#include "VulkanPipelineCache.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "VulkanDevice.h"
+
+namespace vku {
+	namespace {
+		const uint32_t PIPELINE_CACHE_MAGIC = 0x43504b56; // "VKPC"
+
+		// written in front of the driver's blob, since the driver header has no driver version in it
+		struct PipelineCacheFileHeader {
+			uint32_t magic;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			uint64_t dataSize;
+		};
+	}
+
+	VulkanPipelineCache::VulkanPipelineCache(VulkanDevice* device, std::string path) {
+		this->device = device;
+		this->path = path;
+
+		std::vector<char> initialData = load();
+
+		VkPipelineCacheCreateInfo cacheCI{};
+		cacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheCI.initialDataSize = initialData.size();
+		cacheCI.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+		if (vkCreatePipelineCache(*device, &cacheCI, nullptr, &handle) != VK_SUCCESS) {
+			// the driver may still reject a blob that looked valid; start over empty in that case
+			cacheCI.initialDataSize = 0;
+			cacheCI.pInitialData = nullptr;
+			if (vkCreatePipelineCache(*device, &cacheCI, nullptr, &handle) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create pipeline cache!");
+			}
+		}
+	}
+
+	VulkanPipelineCache::~VulkanPipelineCache() {
+		save();
+		vkDestroyPipelineCache(*device, handle, nullptr);
+	}
+
+	std::vector<char> VulkanPipelineCache::load() {
+		if (path.empty()) {
+			return {};
+		}
+
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return {};
+		}
+
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		if (fileSize < sizeof(PipelineCacheFileHeader)) {
+			std::cerr << "Ignoring truncated pipeline cache '" << path << "'." << std::endl;
+			return {};
+		}
+		file.seekg(0);
+
+		PipelineCacheFileHeader header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		const VkPhysicalDeviceProperties& props = device->supportInfo.deviceProperties;
+		if (header.magic != PIPELINE_CACHE_MAGIC
+			|| header.vendorID != props.vendorID
+			|| header.deviceID != props.deviceID
+			|| header.driverVersion != props.driverVersion
+			|| memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			std::cout << "Pipeline cache '" << path << "' was written by a different device or driver, rebuilding." << std::endl;
+			return {};
+		}
+		if (header.dataSize != fileSize - sizeof(header) || header.dataSize < sizeof(VkPipelineCacheHeaderVersionOne)) {
+			std::cerr << "Ignoring corrupt pipeline cache '" << path << "'." << std::endl;
+			return {};
+		}
+
+		std::vector<char> data(header.dataSize);
+		file.read(data.data(), data.size());
+
+		// also check the driver's own header, so we never hand it a blob it didn't write
+		VkPipelineCacheHeaderVersionOne driverHeader;
+		memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+		if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			|| driverHeader.vendorID != props.vendorID
+			|| driverHeader.deviceID != props.deviceID
+			|| memcmp(driverHeader.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+			std::cerr << "Ignoring corrupt pipeline cache '" << path << "'." << std::endl;
+			return {};
+		}
+
+		return data;
+	}
+
+	void VulkanPipelineCache::merge(const std::vector<VkPipelineCache>& caches) {
+		if (caches.empty()) {
+			return;
+		}
+		if (vkMergePipelineCaches(*device, handle, static_cast<uint32_t>(caches.size()), caches.data()) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to merge pipeline caches!");
+		}
+	}
+
+	void VulkanPipelineCache::save() {
+		if (path.empty()) {
+			return;
+		}
+
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(*device, handle, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+			return;
+		}
+		std::vector<char> data(dataSize);
+		if (vkGetPipelineCacheData(*device, handle, &dataSize, data.data()) != VK_SUCCESS) {
+			std::cerr << "Failed to read back pipeline cache data." << std::endl;
+			return;
+		}
+
+		const VkPhysicalDeviceProperties& props = device->supportInfo.deviceProperties;
+		PipelineCacheFileHeader header{};
+		header.magic = PIPELINE_CACHE_MAGIC;
+		header.vendorID = props.vendorID;
+		header.deviceID = props.deviceID;
+		header.driverVersion = props.driverVersion;
+		memcpy(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = dataSize;
+
+		// write to a temporary file first, so a crash mid-write never leaves a corrupt cache behind
+		std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open()) {
+				std::cerr << "Failed to open '" << tmpPath << "' for writing." << std::endl;
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(data.data(), dataSize);
+		}
+		std::remove(path.c_str());
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			std::cerr << "Failed to write pipeline cache '" << path << "'." << std::endl;
+		}
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vku {
+	struct VulkanDevice;
+
+	// a VkPipelineCache that is persisted to disk between runs.
+	// the blob is only reused if it was written by the same device and driver.
+	struct VulkanPipelineCache {
+		VulkanDevice* device;
+		VkPipelineCache handle = VK_NULL_HANDLE;
+
+		std::string path;
+
+		VulkanPipelineCache(VulkanDevice* device, std::string path);
+		~VulkanPipelineCache();
+
+		// fold the contents of other caches (eg. ones owned by worker threads) into this one
+		void merge(const std::vector<VkPipelineCache>& caches);
+		void save();
+
+		operator VkPipelineCache() const { return handle; }
+
+	private:
+		std::vector<char> load();
+	};
+}
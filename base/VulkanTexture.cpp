@@ -10,6 +10,7 @@
 #include <array>
 
 #include "VulkanDevice.h"
+#include "SamplerCache.h"
 
 namespace vku {
 
@@ -22,7 +23,7 @@ namespace vku {
 
 	VulkanImage::~VulkanImage() {
 		vkDestroyImage(*device, handle, nullptr);
-		vkFreeMemory(*device, memory, nullptr);
+		device->memoryAllocator->free(allocation);
 	}
 
 	void VulkanImage::writeImageViewInfo(VulkanImageViewInfo* viewInfo) {
@@ -40,7 +41,7 @@ namespace vku {
 		viewInfo.image = info.image;
 		viewInfo.viewType = info.imageViewType;
 		viewInfo.format = info.format;
-		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.baseMipLevel = info.baseMipLevel;
 		viewInfo.subresourceRange.levelCount = info.mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = info.layerCount;
@@ -90,13 +91,12 @@ namespace vku {
 		image = new VulkanImage(device, info.imageInfo);
 		image->writeImageViewInfo(&info.imageViewInfo);
 		view = new VulkanImageView(device, info.imageViewInfo);
-		sampler = new VulkanSampler(device, info.samplerInfo);
+		sampler = device->samplerCache->get(info.samplerInfo);
 	}
 
 	VulkanTexture::~VulkanTexture() {
 		delete image;
 		delete view;
-		delete sampler;
 	}
 
 	void VulkanImage::transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout) {
@@ -182,7 +182,7 @@ namespace vku {
 		device->submitCommandBuffer(commandBuffer, device->graphicsQueue);
 	}
 
-	void VulkanImage::generateMipmaps() {
+	void VulkanImage::recordMipmaps(VkCommandBuffer commandBuffer) {
 		// check for linear blitting support
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device->physicalDevice, info.format, &formatProperties);
@@ -190,8 +190,6 @@ namespace vku {
 			throw std::runtime_error("Texture image format does not support linear blitting.");
 		}
 
-		VkCommandBuffer commandBuffer = device->beginCommandBuffer(true);
-
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.image = *this;
@@ -266,45 +264,10 @@ namespace vku {
 			0, nullptr,
 			0, nullptr,
 			1, &barrier);
-
-		device->submitCommandBuffer(commandBuffer, device->graphicsQueue);
 	}
 
-	void VulkanImage::copyBufferToImage(VkBuffer buffer) {
-		VkCommandBuffer commandBuffer = device->beginCommandBuffer(true);
-
-		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = info.arrayLayers;
-
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = { info.width, info.height, 1 };
-
-		vkCmdCopyBufferToImage(
-			commandBuffer,
-			buffer,
-			handle,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1,
-			&region
-		);
-
-		device->submitCommandBuffer(commandBuffer, device->graphicsQueue);
-	}
-
-	void VulkanImage::loadFromBuffer(VkBuffer buffer) {
-		// transition layout to transfer destination optimized type
-		transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		// copy data to image
-		copyBufferToImage(buffer);
-		// transition layout to readonly shader data, and generate mip maps (even if it's just one)
-		generateMipmaps();
+	void VulkanImage::upload(const void* data, VkDeviceSize size) {
+		device->uploadManager->uploadImage(this, data, size);
 	}
 
 	VulkanImage::VulkanImage(VulkanDevice* device, const std::string& path) {
@@ -326,24 +289,10 @@ namespace vku {
 
 		VkDeviceSize imageSize = texWidth * texHeight * 4;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(*device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(*device, stagingBufferMemory);
-		stbi_image_free(pixels);
-
-		// create image and load from buffer
+		// create image and queue the pixels for upload
 		init(imageInfo);
-		loadFromBuffer(stagingBuffer);
-
-		vkDestroyBuffer(*device, stagingBuffer, nullptr);
-		vkFreeMemory(*device, stagingBufferMemory, nullptr);
+		upload(pixels, imageSize);
+		stbi_image_free(pixels);
 	}
 
 	// generates a cubemap
@@ -363,23 +312,6 @@ namespace vku {
 		VkDeviceSize layerSize = texWidth * texHeight * 4;
 		VkDeviceSize imageSize = layerSize * paths.size();
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		device->createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(*device, stagingBufferMemory, 0, imageSize, 0, &data);
-		for (int i = 0; i < paths.size(); i++) {
-			memcpy(static_cast<char*>(data) + (layerSize * i), faceData[i], static_cast<size_t>(layerSize));
-		}
-		vkUnmapMemory(*device, stagingBufferMemory);
-
-		for (int i = 0; i < paths.size(); i++) {
-			stbi_image_free(faceData[i]);
-		}
-
 		VulkanImageInfo imageInfo{};
 		imageInfo.width = texWidth;
 		imageInfo.height = texHeight;
@@ -390,15 +322,12 @@ namespace vku {
 		imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
 		init(imageInfo);
 
-		// transition layout to transfer destination optimized type
-		transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		// copy data to image
-		copyBufferToImage(stagingBuffer);
-		// transition layout to readonly shader data, and generate mip maps (even if it's just one)
-		transitionImageLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-		vkDestroyBuffer(*device, stagingBuffer, nullptr);
-		vkFreeMemory(*device, stagingBufferMemory, nullptr);
+		// the faces go straight into the staging memory, one layer after another
+		char* staging = static_cast<char*>(device->uploadManager->stageImage(this, imageSize));
+		for (int i = 0; i < paths.size(); i++) {
+			memcpy(staging + (layerSize * i), faceData[i], static_cast<size_t>(layerSize));
+			stbi_image_free(faceData[i]);
+		}
 	}
 
 	void VulkanImage::init(VulkanImageInfo info) {
@@ -424,19 +353,7 @@ namespace vku {
 			throw std::runtime_error("Failed to create image!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(*device, *this, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = device->findSupportedMemoryType(memRequirements.memoryTypeBits, info.properties);
-
-		if (vkAllocateMemory(*device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to allocate image memory!");
-		}
-
-		vkBindImageMemory(*device, handle, memory, 0);
+		allocation = device->memoryAllocator->allocate(handle, info.tiling, info.properties, info.category);
 
 		this->info = info;
 	}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <string>
+#include <compare>
 
 #include <vulkan/vulkan.h>
 
+#include "memory/MemoryAllocator.h"
+
 namespace vku {
 	struct VulkanDevice;
 
@@ -19,11 +22,12 @@ namespace vku {
 		VkMemoryPropertyFlags properties;
 		VkImageCreateFlags imageCreateFlags = 0;
 		uint32_t arrayLayers = 1;
+		MemoryCategory category = MemoryCategory::Texture;
 	};
 
 	struct VulkanImage {
 		VkImage handle;
-		VkDeviceMemory memory;
+		MemoryAllocation allocation;
 		VulkanDevice* device;
 
 	private:
@@ -41,15 +45,18 @@ namespace vku {
 		void transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
 		void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
 
-		void copyBufferToImage(VkBuffer buffer);
-		void loadFromBuffer(VkBuffer buffer);
+		// queued on the device's UploadManager. fills mip 0 of every layer and generates the rest.
+		void upload(const void* data, VkDeviceSize size);
+		// blits every mip from the one above it, starting with mip 0 in TRANSFER_DST_OPTIMAL. leaves all of them in SHADER_READ_ONLY_OPTIMAL.
+		void recordMipmaps(VkCommandBuffer commandBuffer);
+
+		const VulkanImageInfo& getInfo() const { return info; }
 
 		// allow convenient casting
 		operator VkImage() const { return handle; }
 
 	private:
 		void init(VulkanImageInfo info);
-		void generateMipmaps();
 	};
 
 
@@ -62,6 +69,8 @@ namespace vku {
 		uint32_t mipLevels = 1;
 		VkImageViewType imageViewType = VK_IMAGE_VIEW_TYPE_2D;
 		uint32_t layerCount = 1;
+		// first mip the view sees, eg. to write a single mip as a storage image
+		uint32_t baseMipLevel = 0;
 	};
 
 	struct VulkanImageView {
@@ -90,6 +99,9 @@ namespace vku {
 		float maxLod = 1.0f;
 		VkCompareOp compareOp{};
 		VkBool32 compareEnable = VK_FALSE;
+
+		// ordered so the device's SamplerCache can key on it
+		auto operator<=>(const VulkanSamplerInfo&) const = default;
 	};
 
 	struct VulkanSampler {
@@ -116,6 +128,7 @@ namespace vku {
 	struct VulkanTexture {
 		VulkanImage* image;
 		VulkanImageView* view;
+		// borrowed from the device's SamplerCache, never deleted with the texture
 		VulkanSampler* sampler;
 
 		VulkanTexture() {}
@@ -13,18 +13,15 @@ namespace vku {
 		device->createBuffer(dataSize,
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			buffer, memory);
+			buffer, allocation, MemoryCategory::Uniform);
+		mapped = allocation.mapped;
 	}
 
 	VulkanUniform::~VulkanUniform() {
-		vkDestroyBuffer(*device, buffer, nullptr);
-		vkFreeMemory(*device, memory, nullptr);
+		device->destroyBuffer(buffer, allocation);
 	}
 
 	void VulkanUniform::write(void *global) {
-		void* data;
-		vkMapMemory(*device, memory, 0, dataSize, 0, &data);
-		memcpy(data, global, dataSize);
-		vkUnmapMemory(*device, memory);
+		memcpy(mapped, global, dataSize);
 	}
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include "memory/MemoryAllocator.h"
+
 namespace vku {
 	struct VulkanDevice;
 
@@ -12,7 +14,9 @@ namespace vku {
 		size_t dataSize;
 
 		VkBuffer buffer;
-		VkDeviceMemory memory;
+		MemoryAllocation allocation;
+		// mapped for the lifetime of the uniform
+		void* mapped;
 
 		VulkanUniform(VulkanDevice* device, size_t dataSize);
 		~VulkanUniform();
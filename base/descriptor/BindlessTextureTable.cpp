@@ -0,0 +1,136 @@
+#include "BindlessTextureTable.h"
+
+#include <stdexcept>
+
+#include "../VulkanDevice.h"
+#include "../VulkanTexture.h"
+#include "../CommandRecorder.h"
+#include "../util/DeletionQueue.h"
+
+namespace vku {
+	BindlessTextureTable::BindlessTextureTable(VulkanDevice* device, uint32_t capacity) {
+		this->device = device;
+		this->capacity = capacity;
+
+		// layout: a single, partially bound texture array
+		{
+			VkDescriptorSetLayoutBinding binding{};
+			binding.binding = 0;
+			binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			binding.descriptorCount = capacity;
+			binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+			VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+			VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{};
+			bindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+			bindingFlagsCI.bindingCount = 1;
+			bindingFlagsCI.pBindingFlags = &bindingFlags;
+
+			VkDescriptorSetLayoutCreateInfo layoutCI{};
+			layoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			layoutCI.pNext = &bindingFlagsCI;
+			layoutCI.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+			layoutCI.bindingCount = 1;
+			layoutCI.pBindings = &binding;
+
+			if (vkCreateDescriptorSetLayout(*device, &layoutCI, nullptr, &layout) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create bindless texture layout!");
+			}
+		}
+
+		// a dedicated pool, since update-after-bind sets need a pool created for them
+		{
+			VkDescriptorPoolSize size{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity };
+
+			VkDescriptorPoolCreateInfo poolCI{};
+			poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolCI.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+			poolCI.maxSets = 1;
+			poolCI.poolSizeCount = 1;
+			poolCI.pPoolSizes = &size;
+
+			if (vkCreateDescriptorPool(*device, &poolCI, nullptr, &pool) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create bindless texture pool!");
+			}
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		if (vkAllocateDescriptorSets(*device, &allocInfo, &set) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate bindless texture set!");
+		}
+	}
+
+	BindlessTextureTable::~BindlessTextureTable() {
+		vkDestroyDescriptorPool(*device, pool, nullptr);
+		vkDestroyDescriptorSetLayout(*device, layout, nullptr);
+	}
+
+	uint32_t BindlessTextureTable::registerTexture(VulkanTexture* texture) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = slots.find(texture);
+		if (it != slots.end()) {
+			it->second.refCount++;
+			return it->second.index;
+		}
+
+		uint32_t index;
+		if (!freeIndices.empty()) {
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else if (nextIndex < capacity) {
+			index = nextIndex++;
+		}
+		else {
+			throw std::runtime_error("Bindless texture table is full!");
+		}
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = *texture->view;
+		imageInfo.sampler = *texture->sampler;
+
+		// the slot is unused by every frame in flight, so writing it while the set is bound is fine
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = 0;
+		write.dstArrayElement = index;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(*device, 1, &write, 0, nullptr);
+
+		slots[texture] = { index, 1 };
+		return index;
+	}
+
+	void BindlessTextureTable::unregisterTexture(VulkanTexture* texture) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = slots.find(texture);
+		if (it == slots.end() || --it->second.refCount > 0) {
+			return;
+		}
+
+		uint32_t index = it->second.index;
+		slots.erase(it);
+		device->deletionQueue->push([this, index]() {
+			std::lock_guard<std::mutex> lock(mutex);
+			freeIndices.push_back(index);
+		});
+	}
+
+	void BindlessTextureTable::bind(VkCommandBuffer cb, VkPipelineLayout pipelineLayout) {
+		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, SET_INDEX, 1, &set, 0, nullptr);
+	}
+
+	void BindlessTextureTable::bind(CommandRecorder& recorder, VkPipelineLayout pipelineLayout) {
+		recorder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, SET_INDEX, 1, &set);
+	}
+}
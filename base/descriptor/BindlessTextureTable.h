@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+namespace vku {
+	struct VulkanDevice;
+	struct VulkanTexture;
+	struct CommandRecorder;
+
+	// one device-wide array of sampled textures, indexed from shaders (`layout(set=3, binding=0) uniform sampler2D textures[];`).
+	// backed by descriptor indexing: slots can be written while the set is bound, and unwritten slots are allowed.
+	// materials refer to textures by index, so any number of them share this one set. thread safe.
+	struct BindlessTextureTable {
+		// the set index materials with `VulkanMaterialInfo::bindless` expect the table in
+		static const uint32_t SET_INDEX = 3;
+
+		VulkanDevice* device;
+
+		uint32_t capacity;
+
+		VkDescriptorSetLayout layout;
+		VkDescriptorPool pool;
+		VkDescriptorSet set;
+
+		BindlessTextureTable(VulkanDevice* device, uint32_t capacity);
+		~BindlessTextureTable();
+
+		// the slot of a texture, writing it into the table if it isn't there yet. registering a texture again adds a reference.
+		uint32_t registerTexture(VulkanTexture* texture);
+		// drops a reference. the slot is reused once no frame in flight can sample it.
+		void unregisterTexture(VulkanTexture* texture);
+
+		void bind(VkCommandBuffer cb, VkPipelineLayout pipelineLayout);
+		void bind(CommandRecorder& recorder, VkPipelineLayout pipelineLayout);
+
+	private:
+		struct Slot {
+			uint32_t index;
+			uint32_t refCount;
+		};
+
+		std::mutex mutex;
+		std::unordered_map<VulkanTexture*, Slot> slots;
+		std::vector<uint32_t> freeIndices;
+		uint32_t nextIndex = 0;
+	};
+}
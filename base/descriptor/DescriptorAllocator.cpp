@@ -0,0 +1,119 @@
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "../VulkanDevice.h"
+#include "../util/DeletionQueue.h"
+
+namespace vku {
+	DescriptorPoolChain::DescriptorPoolChain(VulkanDevice* device, const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool) {
+		this->device = device;
+		this->sizesPerSet = sizesPerSet;
+		this->setsPerPool = setsPerPool;
+	}
+
+	DescriptorPoolChain::~DescriptorPoolChain() {
+		if (current != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(*device, current, nullptr);
+		}
+		for (VkDescriptorPool pool : fullPools) {
+			vkDestroyDescriptorPool(*device, pool, nullptr);
+		}
+	}
+
+	VkDescriptorPool DescriptorPoolChain::createPool() {
+		std::vector<VkDescriptorPoolSize> sizes = sizesPerSet;
+		for (VkDescriptorPoolSize& size : sizes) {
+			size.descriptorCount *= setsPerPool;
+		}
+
+		VkDescriptorPoolCreateInfo poolCI{};
+		poolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCI.poolSizeCount = static_cast<uint32_t>(sizes.size());
+		poolCI.pPoolSizes = sizes.data();
+		poolCI.maxSets = setsPerPool;
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(*device, &poolCI, nullptr, &pool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create descriptor pool!");
+		}
+
+		setsPerPool = std::min(setsPerPool * 2, maxSetsPerPool);
+		return pool;
+	}
+
+	void DescriptorPoolChain::nextPool() {
+		if (current != VK_NULL_HANDLE) {
+			fullPools.push_back(current);
+		}
+		current = createPool();
+	}
+
+	VkDescriptorSet DescriptorPoolChain::allocate(VkDescriptorSetLayout layout) {
+		if (current == VK_NULL_HANDLE) {
+			nextPool();
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet set;
+		allocInfo.descriptorPool = current;
+		VkResult result = vkAllocateDescriptorSets(*device, &allocInfo, &set);
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+			// this pool is exhausted, move on to a fresh one
+			nextPool();
+			allocInfo.descriptorPool = current;
+			result = vkAllocateDescriptorSets(*device, &allocInfo, &set);
+		}
+		if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate descriptor set!");
+		}
+
+		setsAllocated++;
+		return set;
+	}
+
+	DescriptorAllocator::DescriptorAllocator(VulkanDevice* device, const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool) {
+		this->device = device;
+		this->staticChain = new DescriptorPoolChain(device, sizesPerSet, setsPerPool);
+	}
+
+	DescriptorAllocator::~DescriptorAllocator() {
+		delete staticChain;
+	}
+
+	VkDescriptorSet DescriptorAllocator::allocate(VulkanDescriptorSetLayout* layout) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = recycled.find(layout->bindings);
+		if (it != recycled.end() && !it->second.empty()) {
+			VkDescriptorSet set = it->second.back();
+			it->second.pop_back();
+			return set;
+		}
+		return staticChain->allocate(layout->handle);
+	}
+
+	void DescriptorAllocator::release(const std::vector<DescriptorLayout>& bindings, VkDescriptorSet set) {
+		device->deletionQueue->push([this, bindings, set]() {
+			std::lock_guard<std::mutex> lock(mutex);
+			recycled[bindings].push_back(set);
+		});
+	}
+
+	DescriptorAllocatorStats DescriptorAllocator::getStats() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		DescriptorAllocatorStats stats{};
+		stats.staticPools = staticChain->poolCount();
+		stats.staticSets = staticChain->setsAllocated;
+		for (auto& [bindings, sets] : recycled) {
+			stats.recycledSets += static_cast<uint32_t>(sets.size());
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "../VulkanDescriptorSet.h"
+
+namespace vku {
+	struct VulkanDevice;
+
+	// a growing list of descriptor pools. sets are never freed back to them; the pools live as long as the chain.
+	struct DescriptorPoolChain {
+		VulkanDevice* device;
+
+		// descriptors of each type per set; scaled by the set count of each pool
+		std::vector<VkDescriptorPoolSize> sizesPerSet;
+		// set count of the next pool. doubles with every pool, up to maxSetsPerPool.
+		uint32_t setsPerPool;
+		uint32_t maxSetsPerPool = 4096;
+
+		// statistics
+		uint32_t setsAllocated = 0;
+
+		DescriptorPoolChain(VulkanDevice* device, const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool);
+		~DescriptorPoolChain();
+
+		VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+		uint32_t poolCount() const { return static_cast<uint32_t>(fullPools.size() + (current != VK_NULL_HANDLE ? 1 : 0)); }
+
+	private:
+		VkDescriptorPool current = VK_NULL_HANDLE;
+		std::vector<VkDescriptorPool> fullPools;
+
+		VkDescriptorPool createPool();
+		void nextPool();
+	};
+
+	struct DescriptorAllocatorStats {
+		uint32_t staticPools;
+		uint32_t staticSets;
+		// sets released and waiting to be handed out again
+		uint32_t recycledSets;
+	};
+
+	// hands out descriptor sets from a growing chain of pools. released sets are recycled for the next set of an identical layout
+	// once the frames in flight are done with them, instead of being freed back to the pool.
+	// thread safe.
+	struct DescriptorAllocator {
+		VulkanDevice* device;
+
+		DescriptorAllocator(VulkanDevice* device, const std::vector<VkDescriptorPoolSize>& sizesPerSet, uint32_t setsPerPool);
+		~DescriptorAllocator();
+
+		VkDescriptorSet allocate(VulkanDescriptorSetLayout* layout);
+		// give a set from allocate() back. it is reused once no frame in flight can reference it.
+		void release(const std::vector<DescriptorLayout>& bindings, VkDescriptorSet set);
+
+		DescriptorAllocatorStats getStats();
+
+	private:
+		std::mutex mutex;
+
+		DescriptorPoolChain* staticChain;
+		// released sets, by the bindings of the layout they were allocated with. sets of identically defined layouts are compatible.
+		std::map<std::vector<DescriptorLayout>, std::vector<VkDescriptorSet>> recycled;
+	};
+}
@@ -0,0 +1,126 @@
+#include "DescriptorLayoutCache.h"
+
+#include <stdexcept>
+#include <tuple>
+
+#include "../VulkanDevice.h"
+#include "../util/DeletionQueue.h"
+
+namespace vku {
+	bool DescriptorLayoutCache::PipelineLayoutKey::operator<(const PipelineLayoutKey& other) const {
+		return std::tie(setLayouts, pushConstRanges) < std::tie(other.setLayouts, other.pushConstRanges);
+	}
+
+	DescriptorLayoutCache::DescriptorLayoutCache(VulkanDevice* device) {
+		this->device = device;
+	}
+
+	DescriptorLayoutCache::~DescriptorLayoutCache() {
+		// only called once the device is idle
+		for (auto& [key, entry] : pipelineLayouts) {
+			vkDestroyPipelineLayout(*device, entry.layout, nullptr);
+		}
+		for (auto& [bindings, entry] : setLayouts) {
+			delete entry.layout;
+		}
+	}
+
+	VulkanDescriptorSetLayout* DescriptorLayoutCache::acquireSetLayout(const std::vector<DescriptorLayout>& bindings) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = setLayouts.find(bindings);
+		if (it != setLayouts.end()) {
+			hits++;
+			it->second.refCount++;
+			return it->second.layout;
+		}
+
+		misses++;
+		VulkanDescriptorSetLayout* layout = new VulkanDescriptorSetLayout(device, bindings);
+		setLayouts[bindings] = { layout, 1 };
+		return layout;
+	}
+
+	void DescriptorLayoutCache::releaseSetLayout(VulkanDescriptorSetLayout* layout) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = setLayouts.find(layout->bindings);
+		if (it == setLayouts.end() || it->second.layout != layout) {
+			throw std::runtime_error("Released a descriptor set layout that isn't cached!");
+		}
+		if (--it->second.refCount > 0) {
+			return;
+		}
+
+		setLayouts.erase(it);
+		device->deletionQueue->push([layout]() {
+			delete layout;
+		});
+	}
+
+	VkPipelineLayout DescriptorLayoutCache::acquirePipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstRanges) {
+		PipelineLayoutKey key;
+		key.setLayouts = setLayouts;
+		for (const VkPushConstantRange& range : pushConstRanges) {
+			key.pushConstRanges.push_back(range.offset);
+			key.pushConstRanges.push_back(range.size);
+			key.pushConstRanges.push_back(range.stageFlags);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = pipelineLayouts.find(key);
+		if (it != pipelineLayouts.end()) {
+			hits++;
+			it->second.refCount++;
+			return it->second.layout;
+		}
+
+		misses++;
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstRanges.data();
+
+		VkPipelineLayout layout;
+		if (vkCreatePipelineLayout(*device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline layout!");
+		}
+
+		pipelineLayouts[key] = { layout, 1 };
+		pipelineLayoutKeys[layout] = key;
+		return layout;
+	}
+
+	void DescriptorLayoutCache::releasePipelineLayout(VkPipelineLayout layout) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto keyIt = pipelineLayoutKeys.find(layout);
+		if (keyIt == pipelineLayoutKeys.end()) {
+			throw std::runtime_error("Released a pipeline layout that isn't cached!");
+		}
+		auto it = pipelineLayouts.find(keyIt->second);
+		if (--it->second.refCount > 0) {
+			return;
+		}
+
+		pipelineLayouts.erase(it);
+		pipelineLayoutKeys.erase(keyIt);
+		VkDevice vkDevice = *device;
+		device->deletionQueue->push([vkDevice, layout]() {
+			vkDestroyPipelineLayout(vkDevice, layout, nullptr);
+		});
+	}
+
+	size_t DescriptorLayoutCache::setLayoutCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return setLayouts.size();
+	}
+
+	size_t DescriptorLayoutCache::pipelineLayoutCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return pipelineLayouts.size();
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "../VulkanDescriptorSet.h"
+
+namespace vku {
+	struct VulkanDevice;
+
+	// hands out shared, reference counted descriptor set layouts and pipeline layouts.
+	// set layouts are keyed by their binding list, pipeline layouts by their set layouts and push constant ranges,
+	// so identical materials and passes end up with the very same handles. thread safe.
+	// released layouts are retired through the device's deletion queue.
+	// a pipeline layout must be released before the set layouts it was built from.
+	struct DescriptorLayoutCache {
+		VulkanDevice* device;
+
+		// statistics
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+
+		DescriptorLayoutCache(VulkanDevice* device);
+		~DescriptorLayoutCache();
+
+		VulkanDescriptorSetLayout* acquireSetLayout(const std::vector<DescriptorLayout>& bindings);
+		void releaseSetLayout(VulkanDescriptorSetLayout* layout);
+
+		VkPipelineLayout acquirePipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstRanges);
+		void releasePipelineLayout(VkPipelineLayout layout);
+
+		size_t setLayoutCount();
+		size_t pipelineLayoutCount();
+
+	private:
+		struct SetLayoutEntry {
+			VulkanDescriptorSetLayout* layout;
+			uint32_t refCount;
+		};
+
+		struct PipelineLayoutKey {
+			std::vector<VkDescriptorSetLayout> setLayouts;
+			// offset, size and stages of each range
+			std::vector<uint32_t> pushConstRanges;
+
+			bool operator<(const PipelineLayoutKey& other) const;
+		};
+		struct PipelineLayoutEntry {
+			VkPipelineLayout layout;
+			uint32_t refCount;
+		};
+
+		std::mutex mutex;
+		std::map<std::vector<DescriptorLayout>, SetLayoutEntry> setLayouts;
+		std::map<PipelineLayoutKey, PipelineLayoutEntry> pipelineLayouts;
+		std::map<VkPipelineLayout, PipelineLayoutKey> pipelineLayoutKeys;
+	};
+}
@@ -0,0 +1,129 @@
+#include "DescriptorWriter.h"
+
+#include <stdexcept>
+
+#include "../VulkanDevice.h"
+#include "../VulkanUniform.h"
+#include "../VulkanTexture.h"
+
+namespace vku {
+	DescriptorWriter::DescriptorWriter(VulkanDevice* device) {
+		this->device = device;
+	}
+
+	DescriptorWriter::~DescriptorWriter() {
+		flush();
+	}
+
+	VkWriteDescriptorSet& DescriptorWriter::add(VulkanDescriptorSet* set, uint32_t binding, VkDescriptorType type) {
+		// the layout knows better, eg. for input attachments
+		if (binding < set->bindings.size()) {
+			type = set->bindings[binding].type;
+		}
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set->handle;
+		descriptorWrite.dstBinding = binding;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = type;
+		descriptorWrite.descriptorCount = 1;
+		writes.push_back(descriptorWrite);
+		return writes.back();
+	}
+
+	void DescriptorWriter::write(VulkanDescriptorSet* set, uint32_t binding, VulkanUniform* uniform) {
+		bufferInfos.push_back(DescriptorData::of(uniform).buffer);
+		add(set, binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER).pBufferInfo = &bufferInfos.back();
+	}
+
+	void DescriptorWriter::write(VulkanDescriptorSet* set, uint32_t binding, VulkanTexture* texture) {
+		imageInfos.push_back(DescriptorData::of(texture).image);
+		add(set, binding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER).pImageInfo = &imageInfos.back();
+	}
+
+	void DescriptorWriter::write(VulkanDescriptorSet* set, uint32_t binding, VkBuffer buffer, VkDeviceSize range, VkDescriptorType type) {
+		bufferInfos.push_back(DescriptorData::of(buffer, range).buffer);
+		add(set, binding, type).pBufferInfo = &bufferInfos.back();
+	}
+
+	void DescriptorWriter::write(VulkanDescriptorSet* set, uint32_t binding, VkImageView view, VkImageLayout layout, VkSampler sampler, VkDescriptorType type) {
+		VkDescriptorImageInfo info{};
+		info.imageLayout = layout;
+		info.imageView = view;
+		info.sampler = sampler;
+		imageInfos.push_back(info);
+		add(set, binding, type).pImageInfo = &imageInfos.back();
+	}
+
+	void DescriptorWriter::flush() {
+		if (writes.empty()) {
+			return;
+		}
+
+		vkUpdateDescriptorSets(*device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		writes.clear();
+		imageInfos.clear();
+		bufferInfos.clear();
+	}
+
+	DescriptorData DescriptorData::of(VulkanUniform* uniform) {
+		return of(uniform->buffer, uniform->dataSize);
+	}
+
+	DescriptorData DescriptorData::of(VulkanTexture* texture) {
+		DescriptorData data{};
+		data.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		data.image.imageView = *texture->view;
+		data.image.sampler = *texture->sampler;
+		return data;
+	}
+
+	DescriptorData DescriptorData::of(VkBuffer buffer, VkDeviceSize range) {
+		DescriptorData data{};
+		data.buffer.buffer = buffer;
+		data.buffer.offset = 0;
+		data.buffer.range = range;
+		return data;
+	}
+
+	DescriptorUpdateTemplate::DescriptorUpdateTemplate(VulkanDescriptorSetLayout* layout) {
+		this->device = layout->device;
+		this->bindings = layout->bindings;
+
+		std::vector<VkDescriptorUpdateTemplateEntry> entries;
+		for (uint32_t i = 0; i < bindings.size(); i++) {
+			VkDescriptorUpdateTemplateEntry entry{};
+			entry.dstBinding = i;
+			entry.dstArrayElement = 0;
+			entry.descriptorCount = 1;
+			entry.descriptorType = bindings[i].type;
+			entry.offset = i * sizeof(DescriptorData);
+			entry.stride = sizeof(DescriptorData);
+			entries.push_back(entry);
+		}
+
+		VkDescriptorUpdateTemplateCreateInfo templateCI{};
+		templateCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+		templateCI.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+		templateCI.pDescriptorUpdateEntries = entries.data();
+		templateCI.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+		templateCI.descriptorSetLayout = layout->handle;
+
+		if (vkCreateDescriptorUpdateTemplate(*device, &templateCI, nullptr, &handle) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create descriptor update template!");
+		}
+	}
+
+	DescriptorUpdateTemplate::~DescriptorUpdateTemplate() {
+		vkDestroyDescriptorUpdateTemplate(*device, handle, nullptr);
+	}
+
+	void DescriptorUpdateTemplate::update(VulkanDescriptorSet* set, const std::vector<DescriptorData>& data) {
+		if (data.size() != bindings.size()) {
+			throw std::runtime_error("Descriptor update template expects one descriptor per binding!");
+		}
+		vkUpdateDescriptorSetWithTemplate(*device, set->handle, handle, data.data());
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+
+#include <vulkan/vulkan.h>
+
+#include "../VulkanDescriptorSet.h"
+
+namespace vku {
+	struct VulkanDevice;
+	struct VulkanUniform;
+	struct VulkanTexture;
+
+	// collects descriptor writes, and submits them all with a single vkUpdateDescriptorSets in flush().
+	// descriptor types are taken from the set's layout where it's known.
+	struct DescriptorWriter {
+		VulkanDevice* device;
+
+		DescriptorWriter(VulkanDevice* device);
+		// flushes whatever is left
+		~DescriptorWriter();
+
+		void write(VulkanDescriptorSet* set, uint32_t binding, VulkanUniform* uniform);
+		void write(VulkanDescriptorSet* set, uint32_t binding, VulkanTexture* texture);
+		void write(VulkanDescriptorSet* set, uint32_t binding, VkBuffer buffer, VkDeviceSize range, VkDescriptorType type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		// for views that aren't a VulkanTexture's, or aren't in SHADER_READ_ONLY_OPTIMAL, eg. storage images
+		void write(VulkanDescriptorSet* set, uint32_t binding, VkImageView view, VkImageLayout layout, VkSampler sampler = VK_NULL_HANDLE, VkDescriptorType type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+		void flush();
+
+	private:
+		// deques, so the pointers in `writes` stay valid as they grow
+		std::deque<VkDescriptorImageInfo> imageInfos;
+		std::deque<VkDescriptorBufferInfo> bufferInfos;
+		std::vector<VkWriteDescriptorSet> writes;
+
+		VkWriteDescriptorSet& add(VulkanDescriptorSet* set, uint32_t binding, VkDescriptorType type);
+	};
+
+	// what a descriptor update template reads for one binding
+	union DescriptorData {
+		VkDescriptorImageInfo image;
+		VkDescriptorBufferInfo buffer;
+
+		static DescriptorData of(VulkanUniform* uniform);
+		static DescriptorData of(VulkanTexture* texture);
+		static DescriptorData of(VkBuffer buffer, VkDeviceSize range);
+	};
+
+	// writes every binding of a set in one call, from an array with one DescriptorData per binding.
+	// get one through VulkanDescriptorSetLayout::getUpdateTemplate().
+	struct DescriptorUpdateTemplate {
+		VulkanDevice* device;
+		VkDescriptorUpdateTemplate handle;
+		std::vector<DescriptorLayout> bindings;
+
+		DescriptorUpdateTemplate(VulkanDescriptorSetLayout* layout);
+		~DescriptorUpdateTemplate();
+
+		void update(VulkanDescriptorSet* set, const std::vector<DescriptorData>& data);
+	};
+}
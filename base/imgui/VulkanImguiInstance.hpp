@@ -2,6 +2,8 @@
 
 #include <vulkan/vulkan.h>
 
+#include <cstdio>
+
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_vulkan.h"
@@ -9,11 +11,17 @@
 #include  "../VulkanContext.h"
 #include  "../VulkanDevice.h"
 #include  "../VulkanSwapchain.h"
+#include  "../VulkanPipelineCache.h"
 #include "../scene/Object.h"
+#include "../memory/MemoryAllocator.h"
 
 namespace vku {
 	struct VulkanImguiInstance : Object {
+		VulkanDevice* device;
+
 		VulkanImguiInstance(VulkanContext *context, VkRenderPass pass) {
+			this->device = context->device;
+
 			IMGUI_CHECKVERSION();
 			ImGui::CreateContext();
 			ImGuiIO& io = ImGui::GetIO();
@@ -27,7 +35,7 @@ namespace vku {
 			init_info.Device = *context->device;
 			init_info.QueueFamily = context->device->supportInfo.graphicsFamily.value();
 			init_info.Queue = context->device->graphicsQueue;
-			init_info.PipelineCache = VK_NULL_HANDLE;
+			init_info.PipelineCache = *context->device->pipelineCache;
 			init_info.DescriptorPool = context->device->descriptorPool;
 			init_info.Allocator = nullptr;
 			init_info.MinImageCount = 2;
@@ -52,6 +60,32 @@ namespace vku {
 			ImGui::Render();
 		}
 
+		// the memory allocator's heaps against their budgets, and what the memory went to.
+		// call between NextFrame and InternalRender.
+		void MemoryWindow() {
+			MemoryStats stats = device->memoryAllocator->getStats();
+			const float MiB = 1024.0f * 1024.0f;
+
+			ImGui::SetNextWindowPos(ImVec2(0, ImGui::GetIO().DisplaySize.y), ImGuiCond_FirstUseEver, ImVec2(0, 1));
+			ImGui::Begin("Device Memory");
+			ImGui::TextUnformatted(device->supportInfo.memoryBudgetSupported ? "Budgets from VK_EXT_memory_budget" : "Budgets are heap sizes");
+			for (uint32_t h = 0; h < stats.heapCount; h++) {
+				const MemoryHeapStats& heap = stats.heaps[h];
+				char overlay[64];
+				snprintf(overlay, sizeof(overlay), "%.0f / %.0f MiB", heap.usage / MiB, heap.budget / MiB);
+				ImGui::Text("Heap %u%s", h, (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "");
+				ImGui::ProgressBar(heap.budget > 0 ? static_cast<float>(heap.usage) / static_cast<float>(heap.budget) : 0.0f, ImVec2(-1, 0), overlay);
+			}
+
+			ImGui::NewLine();
+			for (uint32_t c = 0; c < static_cast<uint32_t>(MemoryCategory::Count); c++) {
+				ImGui::Text("%s: %.1f MiB", memoryCategoryName(static_cast<MemoryCategory>(c)), stats.categoryBytes[c] / MiB);
+			}
+			ImGui::Text("%.1f of %.1f MiB in %u blocks and %u dedicated", stats.usedBytes / MiB, stats.blockBytes / MiB, stats.blockCount, stats.dedicatedCount);
+			ImGui::Text("%u allocations, %.0f%% of free space fragmented", stats.allocationCount, stats.fragmentation * 100.0f);
+			ImGui::End();
+		}
+
 		virtual glm::mat4 getAABBTransform() {
 			return glm::mat4(0.0);
 		};
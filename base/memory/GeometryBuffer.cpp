@@ -0,0 +1,175 @@
+#include "GeometryBuffer.h"
+
+#include <algorithm>
+
+#include "RangeAllocator.h"
+#include "MemoryAllocator.h"
+#include "../VulkanDevice.h"
+#include "../VulkanMesh.h"
+#include "../util/DeletionQueue.h"
+
+namespace vku {
+	struct GeometryArena {
+		VkBuffer vertexBuffer;
+		MemoryAllocation vertexAllocation;
+		VkBuffer indexBuffer;
+		MemoryAllocation indexAllocation;
+
+		// in vertices and indices, not bytes
+		RangeAllocator vertices;
+		RangeAllocator indices;
+
+		// holds exactly one mesh
+		bool dedicated;
+
+		GeometryArena(uint32_t vertices, uint32_t indices) : vertices(vertices), indices(indices) {}
+	};
+
+	GeometryBuffer::GeometryBuffer(VulkanDevice* device, uint32_t arenaVertices, uint32_t arenaIndices) {
+		this->device = device;
+		this->arenaVertices = arenaVertices;
+		this->arenaIndices = arenaIndices;
+	}
+
+	GeometryBuffer::~GeometryBuffer() {
+		// only called once the device is idle and the deletion queue ran
+		for (GeometryArena* arena : arenas) {
+			destroyArena(arena);
+		}
+	}
+
+	GeometryAllocation GeometryBuffer::allocate(const VulkanMeshData& mesh) {
+		uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+
+		GeometryAllocation allocation{};
+		if (vertexCount == 0 && indexCount == 0) {
+			return allocation;
+		}
+
+		bool placed = false;
+		if (vertexCount > arenaVertices || indexCount > arenaIndices) {
+			GeometryArena* arena = createArena(vertexCount, indexCount, true);
+			arenas.push_back(arena);
+			placed = tryAllocate(arena, vertexCount, indexCount, allocation);
+		}
+		for (size_t i = 0; !placed && i < arenas.size(); i++) {
+			if (!arenas[i]->dedicated) {
+				placed = tryAllocate(arenas[i], vertexCount, indexCount, allocation);
+			}
+		}
+		if (!placed) {
+			GeometryArena* arena = createArena(arenaVertices, arenaIndices, false);
+			arenas.push_back(arena);
+			tryAllocate(arena, vertexCount, indexCount, allocation);
+		}
+
+		if (vertexCount > 0) {
+			device->uploadManager->uploadBuffer(allocation.vertexBuffer, allocation.vertexOffset * sizeof(Vertex), mesh.vertices.data(), vertexCount * sizeof(Vertex));
+		}
+		if (indexCount > 0) {
+			device->uploadManager->uploadBuffer(allocation.indexBuffer, allocation.firstIndex * sizeof(uint32_t), mesh.indices.data(), indexCount * sizeof(uint32_t));
+		}
+		return allocation;
+	}
+
+	void GeometryBuffer::free(GeometryAllocation& allocation) {
+		if (allocation.arena == nullptr) {
+			return;
+		}
+
+		GeometryArena* arena = allocation.arena;
+		uint32_t vertexOffset = allocation.vertexOffset, vertexCount = allocation.vertexCount;
+		uint32_t firstIndex = allocation.firstIndex, indexCount = allocation.indexCount;
+		device->deletionQueue->push([this, arena, vertexOffset, vertexCount, firstIndex, indexCount]() {
+			release(arena, vertexOffset, vertexCount, firstIndex, indexCount);
+		});
+		allocation = GeometryAllocation{};
+	}
+
+	GeometryStats GeometryBuffer::getStats() {
+		GeometryStats stats{};
+		for (GeometryArena* arena : arenas) {
+			stats.arenaCount++;
+			stats.vertexCapacity += arena->vertices.capacity();
+			stats.vertexCount += arena->vertices.used();
+			stats.indexCapacity += arena->indices.capacity();
+			stats.indexCount += arena->indices.used();
+		}
+		return stats;
+	}
+
+	GeometryArena* GeometryBuffer::createArena(uint32_t vertices, uint32_t indices, bool dedicated) {
+		// a buffer can't be empty
+		vertices = std::max(vertices, 1u);
+		indices = std::max(indices, 1u);
+
+		GeometryArena* arena = new GeometryArena(vertices, indices);
+		arena->dedicated = dedicated;
+		device->createBuffer(vertices * sizeof(Vertex),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			arena->vertexBuffer, arena->vertexAllocation, MemoryCategory::Geometry);
+		device->createBuffer(indices * sizeof(uint32_t),
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			arena->indexBuffer, arena->indexAllocation, MemoryCategory::Geometry);
+		return arena;
+	}
+
+	void GeometryBuffer::destroyArena(GeometryArena* arena) {
+		device->destroyBuffer(arena->vertexBuffer, arena->vertexAllocation);
+		device->destroyBuffer(arena->indexBuffer, arena->indexAllocation);
+		delete arena;
+	}
+
+	bool GeometryBuffer::tryAllocate(GeometryArena* arena, uint32_t vertexCount, uint32_t indexCount, GeometryAllocation& allocation) {
+		// empty ranges take no space, and don't need to be freed either
+		uint64_t vertexOffset = 0, firstIndex = 0;
+		if (vertexCount > 0) {
+			vertexOffset = arena->vertices.allocate(vertexCount);
+			if (vertexOffset == RangeAllocator::INVALID) {
+				return false;
+			}
+		}
+		if (indexCount > 0) {
+			firstIndex = arena->indices.allocate(indexCount);
+			if (firstIndex == RangeAllocator::INVALID) {
+				if (vertexCount > 0) {
+					arena->vertices.free(vertexOffset, vertexCount);
+				}
+				return false;
+			}
+		}
+
+		allocation.vertexBuffer = arena->vertexBuffer;
+		allocation.indexBuffer = arena->indexBuffer;
+		allocation.vertexOffset = static_cast<uint32_t>(vertexOffset);
+		allocation.vertexCount = vertexCount;
+		allocation.firstIndex = static_cast<uint32_t>(firstIndex);
+		allocation.indexCount = indexCount;
+		allocation.arena = arena;
+		return true;
+	}
+
+	void GeometryBuffer::release(GeometryArena* arena, uint32_t vertexOffset, uint32_t vertexCount, uint32_t firstIndex, uint32_t indexCount) {
+		if (vertexCount > 0) {
+			arena->vertices.free(vertexOffset, vertexCount);
+		}
+		if (indexCount > 0) {
+			arena->indices.free(firstIndex, indexCount);
+		}
+
+		if (!arena->vertices.empty() || !arena->indices.empty()) {
+			return;
+		}
+		// like the memory allocator, keep one shared arena around, so streaming a single mesh in and out doesn't reallocate
+		bool hasSibling = std::any_of(arenas.begin(), arenas.end(), [arena](GeometryArena* other) {
+			return other != arena && !other->dedicated;
+		});
+		if (arena->dedicated || hasSibling) {
+			arenas.erase(std::find(arenas.begin(), arenas.end(), arena));
+			destroyArena(arena);
+		}
+	}
+}
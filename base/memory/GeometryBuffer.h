@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vku {
+	struct VulkanDevice;
+	struct VulkanMeshData;
+	struct GeometryArena;
+
+	// where a mesh lives. vertexOffset and firstIndex go straight into vkCmdDrawIndexed; the indices themselves stay mesh local.
+	struct GeometryAllocation {
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		uint32_t vertexOffset = 0;
+		uint32_t vertexCount = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+
+		// owned by the GeometryBuffer
+		GeometryArena* arena = nullptr;
+	};
+
+	struct GeometryStats {
+		uint32_t arenaCount = 0;
+		uint64_t vertexCapacity = 0;
+		uint64_t vertexCount = 0;
+		uint64_t indexCapacity = 0;
+		uint64_t indexCount = 0;
+	};
+
+	// packs the vertices and indices of every mesh into a few big vertex and index buffers, so draws of different meshes
+	// bind the same buffers and only differ in their offsets. arenas hold a fixed number of vertices and indices,
+	// and a full arena gets a sibling instead of growing, so command buffers recorded against it stay valid.
+	// meshes bigger than an arena get one of their own. use it from the render thread only.
+	struct GeometryBuffer {
+		VulkanDevice* device;
+
+		uint32_t arenaVertices;
+		uint32_t arenaIndices;
+
+		GeometryBuffer(VulkanDevice* device, uint32_t arenaVertices, uint32_t arenaIndices);
+		~GeometryBuffer();
+
+		// places the mesh and queues its upload on the device's UploadManager
+		GeometryAllocation allocate(const VulkanMeshData& mesh);
+		// the ranges are reused once no frame in flight can still draw from them
+		void free(GeometryAllocation& allocation);
+
+		GeometryStats getStats();
+
+	private:
+		std::vector<GeometryArena*> arenas;
+
+		GeometryArena* createArena(uint32_t vertices, uint32_t indices, bool dedicated);
+		void destroyArena(GeometryArena* arena);
+		bool tryAllocate(GeometryArena* arena, uint32_t vertexCount, uint32_t indexCount, GeometryAllocation& allocation);
+		void release(GeometryArena* arena, uint32_t vertexOffset, uint32_t vertexCount, uint32_t firstIndex, uint32_t indexCount);
+	};
+}
@@ -0,0 +1,331 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+
+#include "../VulkanDevice.h"
+
+namespace vku {
+	struct MemoryBlock {
+		enum Kind {
+			// sub-allocated through ranges
+			Shared,
+			// bumped through head, rewound when live drops to 0
+			Transient,
+			// holds exactly one allocation
+			Dedicated
+		};
+
+		Kind kind;
+		VkDeviceMemory memory;
+		uint32_t memoryType;
+		VkDeviceSize size;
+		MemoryResource resource;
+		uint8_t* mapped = nullptr;
+
+		RangeAllocator ranges;
+
+		VkDeviceSize head = 0;
+		uint32_t live = 0;
+
+		MemoryBlock(VkDeviceSize size) : ranges(size) {}
+	};
+
+	const char* memoryCategoryName(MemoryCategory category) {
+		switch (category) {
+		case MemoryCategory::Geometry: return "Geometry";
+		case MemoryCategory::Texture: return "Texture";
+		case MemoryCategory::Attachment: return "Attachment";
+		case MemoryCategory::Uniform: return "Uniform";
+		case MemoryCategory::Storage: return "Storage";
+		case MemoryCategory::Staging: return "Staging";
+		default: return "Other";
+		}
+	}
+
+	static VkDeviceSize toMiB(VkDeviceSize bytes) {
+		return bytes / (1024 * 1024);
+	}
+
+	MemoryAllocator::MemoryAllocator(VulkanDevice* device, VkDeviceSize blockSize, float budgetWarning, VkDeviceSize deviceLocalBudget) {
+		this->device = device;
+		this->blockSize = blockSize;
+		this->budgetWarning = budgetWarning;
+		this->deviceLocalBudget = deviceLocalBudget;
+		this->bufferImageGranularity = device->supportInfo.deviceProperties.limits.bufferImageGranularity;
+
+		vkGetPhysicalDeviceMemoryProperties(device->physicalDevice, &memoryProperties);
+		transientBlocks.resize(memoryProperties.memoryTypeCount, nullptr);
+	}
+
+	MemoryAllocator::~MemoryAllocator() {
+		// only called once the device is idle, after everything allocated from here is gone
+		for (MemoryBlock* block : blocks) {
+			destroyBlock(block);
+		}
+		for (MemoryBlock* block : transientBlocks) {
+			if (block != nullptr) {
+				destroyBlock(block);
+			}
+		}
+	}
+
+	MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category, MemoryResource resource, bool transient) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+		// without a granularity, linear and optimal resources can live side by side
+		if (bufferImageGranularity <= 1) {
+			resource = MemoryResource::Linear;
+		}
+
+		MemoryAllocation allocation{};
+		allocation.size = requirements.size;
+		allocation.category = category;
+
+		MemoryBlock* block = nullptr;
+		VkDeviceSize offset = 0;
+
+		if (transient && resource == MemoryResource::Linear && requirements.size <= blockSize) {
+			MemoryBlock*& linear = transientBlocks[memoryType];
+			if (linear == nullptr) {
+				linear = createBlock(memoryType, blockSize, resource, category);
+				linear->kind = MemoryBlock::Transient;
+			}
+			offset = (linear->head + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+			if (offset + requirements.size <= linear->size) {
+				linear->head = offset + requirements.size;
+				linear->live++;
+				block = linear;
+			}
+		}
+
+		if (block == nullptr && requirements.size > blockSize / 2) {
+			block = createBlock(memoryType, requirements.size, resource, category);
+			block->kind = MemoryBlock::Dedicated;
+			blocks.push_back(block);
+			offset = 0;
+		}
+
+		if (block == nullptr) {
+			for (MemoryBlock* candidate : blocks) {
+				if (candidate->kind != MemoryBlock::Shared || candidate->memoryType != memoryType || candidate->resource != resource) {
+					continue;
+				}
+				offset = candidate->ranges.allocate(requirements.size, requirements.alignment);
+				if (offset != RangeAllocator::INVALID) {
+					block = candidate;
+					break;
+				}
+			}
+		}
+
+		if (block == nullptr) {
+			block = createBlock(memoryType, blockSize, resource, category);
+			block->kind = MemoryBlock::Shared;
+			blocks.push_back(block);
+			offset = block->ranges.allocate(requirements.size, requirements.alignment);
+		}
+
+		allocation.memory = block->memory;
+		allocation.offset = offset;
+		allocation.block = block;
+		if (block->mapped != nullptr) {
+			allocation.mapped = block->mapped + offset;
+		}
+
+		allocationCount++;
+		categoryBytes[static_cast<uint32_t>(category)] += allocation.size;
+		return allocation;
+	}
+
+	MemoryAllocation MemoryAllocator::allocate(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryCategory category, bool transient) {
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(*device, buffer, &requirements);
+
+		MemoryAllocation allocation = allocate(requirements, properties, category, MemoryResource::Linear, transient);
+		vkBindBufferMemory(*device, buffer, allocation.memory, allocation.offset);
+		return allocation;
+	}
+
+	MemoryAllocation MemoryAllocator::allocate(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, MemoryCategory category) {
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(*device, image, &requirements);
+
+		MemoryResource resource = tiling == VK_IMAGE_TILING_LINEAR ? MemoryResource::Linear : MemoryResource::Optimal;
+		MemoryAllocation allocation = allocate(requirements, properties, category, resource);
+		vkBindImageMemory(*device, image, allocation.memory, allocation.offset);
+		return allocation;
+	}
+
+	void MemoryAllocator::free(MemoryAllocation& allocation) {
+		if (allocation.block == nullptr) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+
+		MemoryBlock* block = allocation.block;
+		switch (block->kind) {
+		case MemoryBlock::Transient:
+			if (--block->live == 0) {
+				block->head = 0;
+			}
+			break;
+		case MemoryBlock::Dedicated:
+			blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+			destroyBlock(block);
+			break;
+		case MemoryBlock::Shared:
+			block->ranges.free(allocation.offset, allocation.size);
+			if (block->ranges.empty()) {
+				// keep one block of each kind around, so a single resource coming and going doesn't hit the driver every time
+				bool hasSibling = std::any_of(blocks.begin(), blocks.end(), [block](MemoryBlock* other) {
+					return other != block && other->kind == MemoryBlock::Shared && other->memoryType == block->memoryType && other->resource == block->resource;
+				});
+				if (hasSibling) {
+					blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+					destroyBlock(block);
+				}
+			}
+			break;
+		}
+
+		allocationCount--;
+		categoryBytes[static_cast<uint32_t>(allocation.category)] -= allocation.size;
+		allocation = MemoryAllocation{};
+	}
+
+	MemoryStats MemoryAllocator::getStats() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		MemoryStats stats{};
+		stats.allocationCount = allocationCount;
+		for (uint32_t c = 0; c < static_cast<uint32_t>(MemoryCategory::Count); c++) {
+			stats.categoryBytes[c] = categoryBytes[c];
+		}
+
+		VkDeviceSize freeBytes = 0, strandedBytes = 0;
+		for (MemoryBlock* block : blocks) {
+			stats.blockBytes += block->size;
+			if (block->kind == MemoryBlock::Dedicated) {
+				stats.dedicatedCount++;
+				stats.usedBytes += block->size;
+				continue;
+			}
+			stats.blockCount++;
+			stats.usedBytes += block->ranges.used();
+
+			VkDeviceSize blockFree = block->size - block->ranges.used();
+			freeBytes += blockFree;
+			strandedBytes += blockFree - block->ranges.largestFreeRange();
+		}
+		for (MemoryBlock* block : transientBlocks) {
+			if (block != nullptr) {
+				stats.blockCount++;
+				stats.blockBytes += block->size;
+				stats.usedBytes += block->head;
+			}
+		}
+		if (freeBytes > 0) {
+			stats.fragmentation = static_cast<float>(strandedBytes) / static_cast<float>(freeBytes);
+		}
+
+		VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS], usages[VK_MAX_MEMORY_HEAPS];
+		queryBudget(budgets, usages);
+		stats.heapCount = memoryProperties.memoryHeapCount;
+		for (uint32_t h = 0; h < memoryProperties.memoryHeapCount; h++) {
+			stats.heaps[h].flags = memoryProperties.memoryHeaps[h].flags;
+			stats.heaps[h].size = memoryProperties.memoryHeaps[h].size;
+			stats.heaps[h].budget = budgets[h];
+			stats.heaps[h].usage = usages[h];
+			stats.heaps[h].blockBytes = heapBytes[h];
+		}
+		return stats;
+	}
+
+	MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryType, VkDeviceSize size, MemoryResource resource, MemoryCategory category) {
+		uint32_t heap = memoryProperties.memoryTypes[memoryType].heapIndex;
+		checkBudget(heap, size, category);
+
+		MemoryBlock* block = new MemoryBlock(size);
+		block->memoryType = memoryType;
+		block->size = size;
+		block->resource = resource;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryType;
+		if (vkAllocateMemory(*device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+			delete block;
+			VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS], usages[VK_MAX_MEMORY_HEAPS];
+			queryBudget(budgets, usages);
+			throw std::runtime_error("Failed to allocate " + std::to_string(toMiB(size)) + " MiB of device memory for " + memoryCategoryName(category)
+				+ " in heap " + std::to_string(heap) + ", which is at " + std::to_string(toMiB(usages[heap])) + " of its " + std::to_string(toMiB(budgets[heap])) + " MiB budget!");
+		}
+		heapBytes[heap] += size;
+
+		if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+			vkMapMemory(*device, block->memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&block->mapped));
+		}
+		return block;
+	}
+
+	void MemoryAllocator::destroyBlock(MemoryBlock* block) {
+		if (block->mapped != nullptr) {
+			vkUnmapMemory(*device, block->memory);
+		}
+		vkFreeMemory(*device, block->memory, nullptr);
+		heapBytes[memoryProperties.memoryTypes[block->memoryType].heapIndex] -= block->size;
+		delete block;
+	}
+
+	uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+		throw std::runtime_error("Could not find suitable memory type!");
+	}
+
+	void MemoryAllocator::queryBudget(VkDeviceSize* budgets, VkDeviceSize* usages) {
+		bool queried = device->supportInfo.memoryBudgetSupported;
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		if (queried) {
+			VkPhysicalDeviceMemoryProperties2 properties2{};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			properties2.pNext = &budgetProperties;
+			vkGetPhysicalDeviceMemoryProperties2(device->physicalDevice, &properties2);
+		}
+
+		for (uint32_t h = 0; h < memoryProperties.memoryHeapCount; h++) {
+			const VkMemoryHeap& heap = memoryProperties.memoryHeaps[h];
+			// without the extension, all we know is the heap size and what we allocated ourselves
+			budgets[h] = queried ? budgetProperties.heapBudget[h] : heap.size;
+			usages[h] = queried ? budgetProperties.heapUsage[h] : heapBytes[h];
+			if (deviceLocalBudget > 0 && (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+				budgets[h] = std::min(budgets[h], deviceLocalBudget);
+			}
+		}
+	}
+
+	void MemoryAllocator::checkBudget(uint32_t heap, VkDeviceSize size, MemoryCategory category) {
+		VkDeviceSize budgets[VK_MAX_MEMORY_HEAPS], usages[VK_MAX_MEMORY_HEAPS];
+		queryBudget(budgets, usages);
+
+		VkDeviceSize projected = usages[heap] + size;
+		if (static_cast<double>(projected) <= budgetWarning * static_cast<double>(budgets[heap])) {
+			heapWarned[heap] = false;
+			return;
+		}
+		if (!heapWarned[heap]) {
+			heapWarned[heap] = true;
+			std::cerr << "Device memory heap " << heap << " will be at " << toMiB(projected) << " of its " << toMiB(budgets[heap])
+				<< " MiB budget after allocating " << toMiB(size) << " MiB for " << memoryCategoryName(category) << "." << std::endl;
+		}
+	}
+}
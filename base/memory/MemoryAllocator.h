@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "RangeAllocator.h"
+
+namespace vku {
+	struct VulkanDevice;
+	struct MemoryBlock;
+
+	// what an allocation is for, so statistics can tell where the memory went
+	enum class MemoryCategory : uint32_t {
+		Other,
+		Geometry,
+		Texture,
+		Attachment,
+		Uniform,
+		Storage,
+		Staging,
+		Count
+	};
+
+	const char* memoryCategoryName(MemoryCategory category);
+
+	struct MemoryAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		// address of offset for host visible memory, which stays mapped for as long as its block lives. nullptr otherwise.
+		void* mapped = nullptr;
+		MemoryCategory category = MemoryCategory::Other;
+
+		// owned by the allocator
+		MemoryBlock* block = nullptr;
+	};
+
+	// bufferImageGranularity only concerns neighbouring linear and optimally tiled resources
+	enum class MemoryResource {
+		// buffers and linearly tiled images
+		Linear,
+		// optimally tiled images
+		Optimal
+	};
+
+	// one memory heap, as the allocator and the driver see it
+	struct MemoryHeapStats {
+		VkMemoryHeapFlags flags = 0;
+		VkDeviceSize size = 0;
+		// how much this process can use before the driver evicts or fails allocations. VK_EXT_memory_budget's
+		// estimate, or the heap size without it. device local heaps are capped by MemoryAllocator::deviceLocalBudget.
+		VkDeviceSize budget = 0;
+		// this process's usage as the driver counts it, or the allocator's blockBytes without VK_EXT_memory_budget
+		VkDeviceSize usage = 0;
+		// VkDeviceMemory the allocator holds in the heap
+		VkDeviceSize blockBytes = 0;
+	};
+
+	struct MemoryStats {
+		uint32_t blockCount = 0;
+		uint32_t dedicatedCount = 0;
+		uint32_t allocationCount = 0;
+		// bytes of VkDeviceMemory, and how much of it is handed out
+		VkDeviceSize blockBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		// share of the free bytes in shared blocks that are outside each block's largest free range.
+		// 0 means every block's free space is in one piece.
+		float fragmentation = 0.0f;
+		VkDeviceSize categoryBytes[static_cast<uint32_t>(MemoryCategory::Count)]{};
+
+		uint32_t heapCount = 0;
+		MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS]{};
+	};
+
+	// places buffers and images in a few big VkDeviceMemory blocks per memory type, instead of one allocation each,
+	// which keeps far away from maxMemoryAllocationCount and skips the driver on most allocations. thread safe.
+	// linear and optimal resources get separate blocks if the device has a bufferImageGranularity, so they never share a page.
+	// requests too big for a block get dedicated memory. host visible blocks are mapped once, for their whole lifetime.
+	// every new block is checked against its heap's budget first, which warns once a heap gets close to it.
+	struct MemoryAllocator {
+		VulkanDevice* device;
+
+		VkDeviceSize blockSize;
+		VkDeviceSize bufferImageGranularity;
+		// share of a heap's budget past which new blocks warn
+		float budgetWarning;
+		// caps the budget of device local heaps, to see how a scene fits on a smaller GPU. 0 leaves it to the driver.
+		VkDeviceSize deviceLocalBudget;
+
+		MemoryAllocator(VulkanDevice* device, VkDeviceSize blockSize, float budgetWarning, VkDeviceSize deviceLocalBudget);
+		~MemoryAllocator();
+
+		// transient allocations come from a per-memory-type block that is carved off linearly, and rewound once all of them are freed.
+		// meant for short-lived data like staging buffers. they fall back to the shared blocks if the linear one is full.
+		MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category, MemoryResource resource, bool transient = false);
+		// allocates and binds
+		MemoryAllocation allocate(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryCategory category, bool transient = false);
+		MemoryAllocation allocate(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, MemoryCategory category);
+		// resets the allocation. the resource bound to it must be destroyed, or no longer in use by the GPU.
+		void free(MemoryAllocation& allocation);
+
+		// also queries the heap budgets, so it is cheap but not free
+		MemoryStats getStats();
+
+	private:
+		std::mutex mutex;
+
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		std::vector<MemoryBlock*> blocks;
+		// one per memory type, created on first use
+		std::vector<MemoryBlock*> transientBlocks;
+		uint32_t allocationCount = 0;
+		VkDeviceSize categoryBytes[static_cast<uint32_t>(MemoryCategory::Count)]{};
+		VkDeviceSize heapBytes[VK_MAX_MEMORY_HEAPS]{};
+		// heaps past the warning threshold, which aren't reported again until they drop below it
+		bool heapWarned[VK_MAX_MEMORY_HEAPS]{};
+
+		MemoryBlock* createBlock(uint32_t memoryType, VkDeviceSize size, MemoryResource resource, MemoryCategory category);
+		void destroyBlock(MemoryBlock* block);
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+		void queryBudget(VkDeviceSize* budgets, VkDeviceSize* usages);
+		void checkBudget(uint32_t heap, VkDeviceSize size, MemoryCategory category);
+	};
+}
@@ -0,0 +1,86 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vku {
+	RangeAllocator::RangeAllocator(uint64_t capacity) {
+		this->capacityUnits = capacity;
+		if (capacity > 0) {
+			freeRanges[0] = capacity;
+		}
+	}
+
+	uint64_t RangeAllocator::allocate(uint64_t size, uint64_t alignment) {
+		if (size == 0) {
+			throw std::runtime_error("Cannot allocate an empty range!");
+		}
+		alignment = std::max<uint64_t>(alignment, 1);
+
+		for (auto it = freeRanges.begin(); it != freeRanges.end(); it++) {
+			uint64_t start = it->first;
+			uint64_t end = start + it->second;
+			uint64_t offset = (start + alignment - 1) / alignment * alignment;
+			if (offset + size > end) {
+				continue;
+			}
+
+			// the padding in front and whatever is left behind stay free
+			freeRanges.erase(it);
+			if (offset > start) {
+				freeRanges[start] = offset - start;
+			}
+			if (offset + size < end) {
+				freeRanges[offset + size] = end - (offset + size);
+			}
+
+			usedUnits += size;
+			return offset;
+		}
+		return INVALID;
+	}
+
+	void RangeAllocator::free(uint64_t offset, uint64_t size) {
+		if (offset + size > capacityUnits || size > usedUnits) {
+			throw std::runtime_error("Freed a range that was never allocated!");
+		}
+		usedUnits -= size;
+		insertFree(offset, size);
+	}
+
+	void RangeAllocator::grow(uint64_t newCapacity) {
+		if (newCapacity <= capacityUnits) {
+			return;
+		}
+		uint64_t oldCapacity = capacityUnits;
+		capacityUnits = newCapacity;
+		insertFree(oldCapacity, newCapacity - oldCapacity);
+	}
+
+	uint64_t RangeAllocator::largestFreeRange() const {
+		uint64_t largest = 0;
+		for (auto& [offset, size] : freeRanges) {
+			largest = std::max(largest, size);
+		}
+		return largest;
+	}
+
+	void RangeAllocator::insertFree(uint64_t offset, uint64_t size) {
+		auto next = freeRanges.lower_bound(offset);
+
+		// merge with the range right after
+		if (next != freeRanges.end() && offset + size == next->first) {
+			size += next->second;
+			next = freeRanges.erase(next);
+		}
+		// and the one right before
+		if (next != freeRanges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				prev->second += size;
+				return;
+			}
+		}
+		freeRanges[offset] = size;
+	}
+}
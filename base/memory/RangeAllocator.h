@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+
+namespace vku {
+	// hands out aligned ranges of [0, capacity) from a free list, merging neighbouring ranges as they are freed.
+	// knows nothing about Vulkan: it places memory within a VkDeviceMemory block just as well as elements within a shared buffer.
+	// not thread safe.
+	struct RangeAllocator {
+		static const uint64_t INVALID = ~0ull;
+
+		RangeAllocator(uint64_t capacity);
+
+		// first free range that fits. returns INVALID if none does.
+		uint64_t allocate(uint64_t size, uint64_t alignment = 1);
+		// size must be the one the range was allocated with
+		void free(uint64_t offset, uint64_t size);
+		// adds [capacity, newCapacity) to the free space
+		void grow(uint64_t newCapacity);
+
+		uint64_t capacity() const { return capacityUnits; }
+		uint64_t used() const { return usedUnits; }
+		bool empty() const { return usedUnits == 0; }
+		uint64_t largestFreeRange() const;
+		size_t freeRangeCount() const { return freeRanges.size(); }
+
+	private:
+		uint64_t capacityUnits;
+		uint64_t usedUnits = 0;
+		// offset -> size, never adjacent to each other
+		std::map<uint64_t, uint64_t> freeRanges;
+
+		void insertFree(uint64_t offset, uint64_t size);
+	};
+}
@@ -4,7 +4,9 @@
 
 #include "../VulkanDevice.h"
 #include "../VulkanTexture.h"
+#include "../SamplerCache.h"
 #include "../VulkanMaterial.h"
+#include "../VulkanPipelineCache.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -52,7 +54,7 @@ namespace vku {
 		samplerInfo.minLod = 0.0f;
 		samplerInfo.maxLod = static_cast<float>(numMips);
 		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		texture->sampler = new VulkanSampler(device, samplerInfo);
+		texture->sampler = device->samplerCache->get(samplerInfo);
 
 		// FB, Att, RP, Pipe, etc.
 		VkAttachmentDescription attDesc = {};
@@ -215,7 +217,7 @@ namespace vku {
 		pipelineBuilder.pipeline.renderPass = renderpass;
 
 		VkPipeline pipeline;
-		if (vkCreateGraphicsPipelines(*device, nullptr, 1, &pipelineBuilder.pipeline, nullptr, &pipeline) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(*device, *device->pipelineCache, 1, &pipelineBuilder.pipeline, nullptr, &pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create graphics pipeline.");
 		}
 
@@ -5,6 +5,7 @@
 #include "../shader/ShaderVariant.h"
 #include "../VulkanUniform.h"
 #include "../scene/Scene.h"
+#include "../descriptor/DescriptorWriter.h"
 
 namespace vku {
 	PbrMaterial::PbrMaterial(
@@ -23,12 +24,16 @@ namespace vku {
 		this->mat = new VulkanMaterial(&info, scene, pass);
 		this->matInstance = new VulkanMaterialInstance(mat);
 
-		for (uint32_t i = 0; i < matInstance->descriptorSets.size(); i++) {
-			this->matInstance->descriptorSets[i]->write(0, albedo);
-			this->matInstance->descriptorSets[i]->write(1, normal);
-			this->matInstance->descriptorSets[i]->write(2, metallicRoughness);
-			this->matInstance->descriptorSets[i]->write(3, emissive);
-			this->matInstance->descriptorSets[i]->write(4, ao);
+		std::vector<DescriptorData> descriptors{
+			DescriptorData::of(albedo),
+			DescriptorData::of(normal),
+			DescriptorData::of(metallicRoughness),
+			DescriptorData::of(emissive),
+			DescriptorData::of(ao)
+		};
+		DescriptorUpdateTemplate* updateTemplate = mat->descriptorSetLayout->getUpdateTemplate();
+		for (VulkanDescriptorSet* set : matInstance->descriptorSets) {
+			updateTemplate->update(set, descriptors);
 		}
 	}
 	PbrMaterial::~PbrMaterial() {
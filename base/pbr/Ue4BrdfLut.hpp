@@ -8,7 +8,9 @@
 #include "../shader/ShaderModule.h"
 #include "../VulkanMaterial.h"
 #include "../VulkanTexture.h"
+#include "../SamplerCache.h"
 #include "../VulkanDescriptorSet.h"
+#include "../VulkanPipelineCache.h"
 #include "../shader/ShaderCache.h"
 
 namespace vku {
@@ -35,7 +37,7 @@ namespace vku {
 		VulkanSamplerInfo samplerInfo{};
 		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
 		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		texture->sampler = new VulkanSampler(device, samplerInfo);
+		texture->sampler = device->samplerCache->get(samplerInfo);
 
 		// FB, Att, RP, Pipe, etc.
 		VkAttachmentDescription attDesc = {};
@@ -184,7 +186,7 @@ namespace vku {
 		pipelineBuilder.linkPointers();
 
 		VkPipeline pipeline;
-		if (vkCreateGraphicsPipelines(*device, nullptr, 1, &pipelineBuilder.pipeline, nullptr, &pipeline) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(*device, *device->pipelineCache, 1, &pipelineBuilder.pipeline, nullptr, &pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create graphics pipeline!");
 		}
 
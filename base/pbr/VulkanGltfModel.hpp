@@ -9,11 +9,16 @@
 
 #include "VulkanMesh.h"
 #include "VulkanTexture.h"
+#include "SamplerCache.h"
 #include "VulkanDevice.h"
 #include "scene/Scene.h"
 #include "scene/Object.h"
+#include "scene/ObjectBuffer.h"
 #include "VulkanMaterial.h"
+#include "CommandRecorder.h"
 #include "TextureCommons.h"
+#include "descriptor/BindlessTextureTable.h"
+#include "descriptor/DescriptorWriter.h"
 
 
 /*
@@ -28,6 +33,11 @@ namespace vku {
 			uint32_t firstIndex;
 			uint32_t indexCount;
 			int32_t materialIndex;
+			// entry in the scene's ObjectBuffer
+			uint32_t objectIndex;
+			// mesh space bounding box
+			glm::vec3 min;
+			glm::vec3 max;
 		};
 
 		// Contains the node's (optional) geometry and can be made up of an arbitrary number of primitives
@@ -47,14 +57,31 @@ namespace vku {
 
 		glm::mat4 aabb;
 
+		// texture slots of one material in the bindless texture table, as laid out in pbr_gbuf.frag
+		struct BindlessMaterial {
+			uint32_t albedo;
+			uint32_t normal;
+			uint32_t metallicRoughness;
+			uint32_t emissive;
+			uint32_t ao;
+		};
+
 		std::vector<VulkanTexture*> textures;
+		// with bindless, materials only differ by their index into this buffer, kept in each primitive's object data
+		bool bindless = false;
+		std::vector<VulkanTexture*> registeredTextures;
+		VkBuffer materialBuffer = VK_NULL_HANDLE;
+		MemoryAllocation materialAllocation;
 		std::vector<VulkanMaterial*> materials;
 		std::vector<VulkanMaterialInstance*> materialInstances;
 		std::vector<Node> nodes;
 
 		VulkanGltfModel() {}
 
-		VulkanGltfModel(const std::string& filename, Scene* scene, Pass* pass, std::map<std::string, std::string> macros = {}) {
+		// with asyncPipelines, the constructor doesn't wait for material pipelines; they are drawn with the pass fallback until ready
+		VulkanGltfModel(const std::string& filename, Scene* scene, Pass* pass, std::map<std::string, std::string> macros = {}, bool asyncPipelines = false) {
+			this->scene = scene;
+
 			tinygltf::Model model;
 
 			tinygltf::TinyGLTF loader;
@@ -84,7 +111,7 @@ namespace vku {
 				std::cout << "Loaded glTF: " << filename << std::endl;
 
 			loadTextures(scene->device, model);
-			loadMaterials(scene, pass, model, macros);
+			loadMaterials(scene, pass, model, macros, asyncPipelines);
 
 			VulkanMeshData meshData;
 
@@ -93,6 +120,9 @@ namespace vku {
 				loadNode(gNode, model, nullptr, meshData.indices, meshData.vertices);
 				Node& node = nodes[i];
 			}
+			for (Node& node : nodes) {
+				allocateObjects(node);
+			}
 
 			MikktCalculator mikkt;
 			mikkt.generateTangentSpace(&meshData);
@@ -134,17 +164,6 @@ namespace vku {
 			// Load texture from image buffer
 			ImageWithView image{};
 			{
-				VkBuffer stagingBuffer;
-				VkDeviceMemory stagingBufferMemory;
-				device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-					stagingBuffer, stagingBufferMemory);
-
-				void* data;
-				vkMapMemory(*device, stagingBufferMemory, 0, bufferSize, 0, &data);
-				memcpy(data, buffer, static_cast<size_t>(bufferSize));
-				vkUnmapMemory(*device, stagingBufferMemory);
-
 				VulkanImageInfo info{};
 				info.width = gImage.width;
 				info.height = gImage.height;
@@ -152,10 +171,7 @@ namespace vku {
 				info.format = VK_FORMAT_R8G8B8A8_UNORM;
 				info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 				image.image = new VulkanImage(device, info);
-				image.image->loadFromBuffer(stagingBuffer);
-
-				vkDestroyBuffer(*device, stagingBuffer, nullptr);
-				vkFreeMemory(*device, stagingBufferMemory, nullptr);
+				image.image->upload(buffer, bufferSize);
 
 				VulkanImageViewInfo viewInfo{};
 				image.image->writeImageViewInfo(&viewInfo);
@@ -202,9 +218,8 @@ namespace vku {
 			info.addressModeV = convertTinyGltfAddressMode(gSampler.wrapS);
 			info.addressModeW = convertTinyGltfAddressMode(gSampler.wrapT);
 
-			VulkanSampler* sampler = new VulkanSampler(device, info);
-
-			return sampler;
+			// glTF files tend to repeat a few sampler configurations across all their textures
+			return device->samplerCache->get(info);
 		}
 		void loadTextures(VulkanDevice* device, tinygltf::Model& model) {
 			textures.resize(model.textures.size());
@@ -219,9 +234,17 @@ namespace vku {
 			}
 		}
 
-		void loadMaterials(Scene* scene, Pass* pass, tinygltf::Model& model, std::map<std::string, std::string> macros) {
+		void loadMaterials(Scene* scene, Pass* pass, tinygltf::Model& model, std::map<std::string, std::string> macros, bool asyncPipelines) {
 			materials.resize(model.materials.size());
-			materialInstances.reserve(model.materials.size());
+			materialInstances.resize(model.materials.size());
+
+			// sample through the device texture table when there is one
+			BindlessTextureTable* table = scene->device->bindlessTextures;
+			bindless = table != nullptr && macros.find("TEXTURELESS") == macros.end() && !model.materials.empty();
+			std::vector<BindlessMaterial> bindlessMaterials;
+			if (bindless) {
+				macros["BINDLESS"] = "";
+			}
 
 			for (uint32_t i = 0; i < model.materials.size(); i++) {
 				tinygltf::Material& gMaterial = model.materials[i];
@@ -253,20 +276,63 @@ namespace vku {
 
 				VulkanMaterialInfo info{};
 				if (gMaterial.doubleSided) info.rasterizer.cullMode = VK_CULL_MODE_NONE;
-				macros["ALPHA_CUTOFF"] = std::to_string(gMaterial.alphaCutoff);
+
+				// every cutoff shares one shader module, the value is specialized into the pipeline
+				std::map<std::string, SpecializationConstant> constants;
+				if (gMaterial.alphaMode == "MASK") {
+					constants["ALPHA_MASK"] = true;
+					constants["ALPHA_CUTOFF"] = static_cast<float>(gMaterial.alphaCutoff);
+				}
 
 				info.shaderStages.push_back({ "pbr/pbr_gbuf.vert", macros });
-				info.shaderStages.push_back({ "pbr/pbr_gbuf.frag", macros });
-				material = new VulkanMaterial(&info, scene, pass);
+				info.shaderStages.push_back({ "pbr/pbr_gbuf.frag", macros, constants });
+
+				if (bindless) {
+					VulkanTexture* materialTextures[] = { colorTexture, normalTexture, metallicTexture, emissiveTexture, aoTexture };
+					uint32_t slots[5];
+					for (uint32_t t = 0; t < 5; t++) {
+						slots[t] = table->registerTexture(materialTextures[t]);
+						registeredTextures.push_back(materialTextures[t]);
+					}
+					bindlessMaterials.push_back({ slots[0], slots[1], slots[2], slots[3], slots[4] });
+
+					// every material's set points at the same buffer
+					info.bindless = true;
+					info.descriptorLayouts = { { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS } };
+					material = new VulkanMaterial(&info, scene, pass, asyncPipelines);
+					matInstance = new VulkanMaterialInstance(material);
+					continue;
+				}
+
+				// albedo, normal, metallic/roughness, emissive, ao
+				info.descriptorLayouts = std::vector<DescriptorLayout>(5, { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS });
+				material = new VulkanMaterial(&info, scene, pass, asyncPipelines);
 				matInstance = new VulkanMaterialInstance(material);
 
-				for (uint32_t i = 0; i < matInstance->descriptorSets.size(); i++) {
-					matInstance->descriptorSets[i]->write(0, colorTexture);
-					matInstance->descriptorSets[i]->write(1, normalTexture);
-					matInstance->descriptorSets[i]->write(2, metallicTexture);
-					matInstance->descriptorSets[i]->write(3, emissiveTexture);
-					matInstance->descriptorSets[i]->write(4, aoTexture);
+				// the layout is the same for every material, so this is one template update per set
+				std::vector<DescriptorData> descriptors{
+					DescriptorData::of(colorTexture),
+					DescriptorData::of(normalTexture),
+					DescriptorData::of(metallicTexture),
+					DescriptorData::of(emissiveTexture),
+					DescriptorData::of(aoTexture)
+				};
+				DescriptorUpdateTemplate* updateTemplate = material->descriptorSetLayout->getUpdateTemplate();
+				for (VulkanDescriptorSet* set : matInstance->descriptorSets) {
+					updateTemplate->update(set, descriptors);
+				}
+			}
+
+			if (bindless) {
+				VkDeviceSize size = sizeof(BindlessMaterial) * bindlessMaterials.size();
+				scene->device->initDeviceLocalBuffer(bindlessMaterials, materialBuffer, materialAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryCategory::Storage);
+				DescriptorWriter writer(scene->device);
+				for (VulkanMaterialInstance* matInstance : materialInstances) {
+					for (VulkanDescriptorSet* set : matInstance->descriptorSets) {
+						writer.write(set, 0, materialBuffer, size);
+					}
 				}
+				writer.flush();
 			}
 		}
 
@@ -300,6 +366,7 @@ namespace vku {
 					uint32_t firstIndex = static_cast<uint32_t>(indexBuffer.size());
 					uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
 					uint32_t indexCount = 0;
+					glm::vec3 primitiveMin, primitiveMax;
 
 					// Vertex
 					{
@@ -308,6 +375,8 @@ namespace vku {
 						const float* tangentsBuffer = nullptr;
 						const float* texCoordsBuffer = nullptr;
 						size_t vertexCount = 0;
+						primitiveMin = glm::vec3(std::numeric_limits<float>::infinity());
+						primitiveMax = glm::vec3(-std::numeric_limits<float>::infinity());
 
 						if (gPrimitive.attributes.find("POSITION") != gPrimitive.attributes.end()) {
 							const tinygltf::Accessor& accessor = model.accessors[gPrimitive.attributes.find("POSITION")->second];
@@ -341,6 +410,9 @@ namespace vku {
 							vert.color = glm::vec3(1.0f);
 							vertexBuffer.push_back(vert);
 
+							primitiveMin = glm::min(primitiveMin, vert.pos);
+							primitiveMax = glm::max(primitiveMax, vert.pos);
+
 							// calculate bounding box
 							glm::vec4 transformedVert = glm::vec4(vert.pos, 1.0f);
 							glm::mat4 nodeMatrix = node.matrix;
@@ -400,6 +472,8 @@ namespace vku {
 					primitive.firstIndex = firstIndex;
 					primitive.indexCount = indexCount;
 					primitive.materialIndex = gPrimitive.material;
+					primitive.min = primitiveMin;
+					primitive.max = primitiveMax;
 					node.mesh.primitives.push_back(primitive);
 				}
 			}
@@ -412,42 +486,104 @@ namespace vku {
 			}
 		}
 
-		void drawNode(VkCommandBuffer commandBuffer, uint32_t i, Node& node, bool noMaterial) {
-			if (node.mesh.primitives.size() > 0) {
-				// Pass the node's matrix via push constants
-				// Traverse the node hierarchy to the top-most parent to get the final matrix of the current node
-				glm::mat4 nodeMatrix = node.matrix;
-				Node* currentParent = node.parent;
-				while (currentParent) {
-					nodeMatrix = currentParent->matrix * nodeMatrix;
-					currentParent = currentParent->parent;
+		// one object buffer entry per primitive, since each may have its own material
+		void allocateObjects(Node& node) {
+			for (Primitive& primitive : node.mesh.primitives) {
+				primitive.objectIndex = scene->objectBuffer->allocate();
+				ObjectData& object = (*scene->objectBuffer)[primitive.objectIndex];
+				object.materialIndex = primitive.materialIndex < 0 ? 0 : static_cast<uint32_t>(primitive.materialIndex);
+				object.boundsMin = primitive.min;
+				object.boundsMax = primitive.max;
+			}
+			for (Node& child : node.children) {
+				allocateObjects(child);
+			}
+		}
+
+		void freeObjects(Node& node) {
+			for (Primitive& primitive : node.mesh.primitives) {
+				scene->objectBuffer->free(primitive.objectIndex);
+			}
+			for (Node& child : node.children) {
+				freeObjects(child);
+			}
+		}
+
+		void updateNodeObjects(Node& node, const glm::mat4& parentMatrix) {
+			glm::mat4 nodeMatrix = parentMatrix * node.matrix;
+			for (Primitive& primitive : node.mesh.primitives) {
+				(*scene->objectBuffer)[primitive.objectIndex].transform = nodeMatrix;
+			}
+			for (Node& child : node.children) {
+				updateNodeObjects(child, nodeMatrix);
+			}
+		}
+
+		virtual void updateObjectData() override {
+			for (Node& node : nodes) {
+				updateNodeObjects(node, localTransform);
+			}
+		}
+
+		void collectNodeDraws(Node& node, std::vector<DrawPacket>& packets) {
+			for (Primitive& primitive : node.mesh.primitives) {
+				if (primitive.indexCount > 0) {
+					DrawPacket packet{};
+					packet.materialInstance = materialInstances[primitive.materialIndex];
+					packet.vertexBuffer = meshBuf->geometry.vertexBuffer;
+					packet.indexBuffer = meshBuf->geometry.indexBuffer;
+					packet.indexCount = primitive.indexCount;
+					packet.firstIndex = meshBuf->geometry.firstIndex + primitive.firstIndex;
+					packet.vertexOffset = meshBuf->geometry.vertexOffset;
+					packet.objectIndex = primitive.objectIndex;
+					packets.push_back(packet);
 				}
-				nodeMatrix = localTransform * nodeMatrix;
+			}
+			for (Node& child : node.children) {
+				collectNodeDraws(child, packets);
+			}
+		}
+
+		virtual bool collectDraws(std::vector<DrawPacket>& packets) override {
+			for (Node& node : nodes) {
+				collectNodeDraws(node, packets);
+			}
+			return true;
+		}
 
+		void drawNode(CommandRecorder& recorder, uint32_t i, Node& node, bool noMaterial) {
+			if (node.mesh.primitives.size() > 0) {
 				for (Primitive& primitive : node.mesh.primitives) {
 					if (primitive.indexCount > 0) {
 						VulkanMaterialInstance* materialInstance = materialInstances[primitive.materialIndex];
 						if (!noMaterial) {
-							materialInstance->material->bind(commandBuffer);
-							materialInstance->bind(commandBuffer, i);
+							// the pipeline may still be compiling, in which case the pass fallback is drawn instead
+							materialInstance = materialInstance->resolve();
+							if (materialInstance == nullptr) {
+								continue;
+							}
+							// consecutive primitives mostly share both, so the recorder drops the repeats
+							materialInstance->material->bind(recorder);
+							materialInstance->bind(recorder, i);
 						}
 
-						vkCmdPushConstants(commandBuffer, materialInstance->material->scene->globalPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &nodeMatrix);
-						vkCmdDrawIndexed(commandBuffer, primitive.indexCount, 1, primitive.firstIndex, 0, 0);
+						// transform and material index come from the object buffer
+						scene->pushObjectIndex(recorder, primitive.objectIndex);
+						recorder.drawIndexed(primitive.indexCount, 1, meshBuf->geometry.firstIndex + primitive.firstIndex, meshBuf->geometry.vertexOffset, 0);
 					}
 				}
 			}
 			for (auto& child : node.children) {
-				drawNode(commandBuffer, i, child, noMaterial);
+				drawNode(recorder, i, child, noMaterial);
 			}
 		}
 
 		virtual void render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial) {
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindVertexBuffers(cmdBuf, 0, 1, &meshBuf->vBuffer, offsets);
-			vkCmdBindIndexBuffer(cmdBuf, meshBuf->iBuffer, 0, VK_INDEX_TYPE_UINT32);
+			CommandRecorder recorder(cmdBuf);
+			recorder.bindVertexBuffer(meshBuf->geometry.vertexBuffer);
+			recorder.bindIndexBuffer(meshBuf->geometry.indexBuffer);
 			for (auto& node : nodes) {
-				drawNode(cmdBuf, swapIdx, node, noMaterial);
+				drawNode(recorder, swapIdx, node, noMaterial);
 			}
 		}
 
@@ -456,7 +592,14 @@ namespace vku {
 		}
 
 		~VulkanGltfModel() {
-
+			for (Node& node : nodes) {
+				freeObjects(node);
+			}
+			if (bindless) {
+				for (VulkanTexture* texture : registeredTextures) {
+					meshBuf->device->bindlessTextures->unregisterTexture(texture);
+				}
+			}
 			for (VulkanTexture* texture : textures) {
 				delete texture;
 			}
@@ -466,6 +609,10 @@ namespace vku {
 			for (VulkanMaterialInstance* materialInst : materialInstances) {
 				delete materialInst;
 			}
+			if (materialBuffer != VK_NULL_HANDLE) {
+				VulkanDevice* device = meshBuf->device;
+				device->destroyBuffer(materialBuffer, materialAllocation);
+			}
 			delete meshBuf;
 		}
 	};
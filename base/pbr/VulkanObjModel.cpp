@@ -12,6 +12,7 @@
 
 #include "../VulkanMesh.h"
 #include "../scene/Scene.h"
+#include "../scene/ObjectBuffer.h"
 #include "PbrMaterial.h"
 
 static std::string GetBaseDir(const std::string& filepath) {
@@ -23,6 +24,7 @@ static std::string GetBaseDir(const std::string& filepath) {
 namespace vku {
 
 	VulkanObjModel::VulkanObjModel(const std::string& filename, Scene* scene, Pass* pass, std::map<std::string, std::string> macros) {
+		this->scene = scene;
 		VulkanMeshData meshData{};
 
 		std::string base_dir = GetBaseDir(filename);
@@ -94,6 +96,11 @@ namespace vku {
 
 		this->meshBuf = new VulkanMeshBuffer(scene->device, meshData);
 
+		objectIndex = scene->objectBuffer->allocate();
+		ObjectData& object = (*scene->objectBuffer)[objectIndex];
+		object.boundsMin = min;
+		object.boundsMax = max;
+
 		// load material, based on default Blender BSDF .mtl export
 		if (materials.size() > 0) {
 			tinyobj::material_t mat = materials[0];
@@ -113,6 +120,7 @@ namespace vku {
 	}
 
 	VulkanObjModel::~VulkanObjModel() {
+		scene->objectBuffer->free(objectIndex);
 		delete meshBuf;
 		delete mat;
 	}
@@ -122,10 +130,27 @@ namespace vku {
 			mat->mat->bind(cmdBuf);
 			mat->matInstance->bind(cmdBuf, swapIdx);
 		}
-		vkCmdPushConstants(cmdBuf, mat->mat->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &this->localTransform);
+		scene->pushObjectIndex(cmdBuf, objectIndex);
 		meshBuf->draw(cmdBuf);
 	}
 
+	bool VulkanObjModel::collectDraws(std::vector<DrawPacket>& packets) {
+		DrawPacket packet{};
+		packet.materialInstance = mat->matInstance;
+		packet.vertexBuffer = meshBuf->geometry.vertexBuffer;
+		packet.indexBuffer = meshBuf->geometry.indexBuffer;
+		packet.indexCount = meshBuf->indicesSize;
+		packet.firstIndex = meshBuf->geometry.firstIndex;
+		packet.vertexOffset = meshBuf->geometry.vertexOffset;
+		packet.objectIndex = objectIndex;
+		packets.push_back(packet);
+		return true;
+	}
+
+	void VulkanObjModel::updateObjectData() {
+		(*scene->objectBuffer)[objectIndex].transform = localTransform;
+	}
+
 	glm::mat4 VulkanObjModel::getAABBTransform()
 	{
 		return localTransform * aabb;
@@ -17,9 +17,14 @@ namespace vku {
 		TexturelessPbrMaterial* mat;
 
 		glm::mat4 aabb;
+		// entry in the scene's ObjectBuffer
+		uint32_t objectIndex;
+
 		VulkanObjModel(const std::string& filename, Scene* scene, Pass* pass, std::map<std::string, std::string> macros = {});
 		~VulkanObjModel();
 		virtual void render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial) override;
 		virtual glm::mat4 getAABBTransform() override;
+		virtual void updateObjectData() override;
+		virtual bool collectDraws(std::vector<DrawPacket>& packets) override;
 	};
 }
\ No newline at end of file
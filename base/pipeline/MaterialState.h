@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include "../VulkanMaterial.h"
+
+namespace vku {
+	// calls visitor(field) on every plain field of a material's pipeline state, and on its vectors of plain structs.
+	// the create info structs carry pointers, so only their plain fields are visited.
+	// shared by the pipeline hash and the usage log, so the two can't drift apart.
+	// not visited: the render pass, subpass and sample count (taken from the pass), shader stages, descriptor layouts and the sample mask.
+	template <typename Info, typename Visitor>
+	void visitMaterialState(Info& info, Visitor& visitor) {
+		visitor(info.pipeline.flags);
+
+		visitor(info.pushConstRanges);
+
+		visitor(info.inputAssembly.topology);
+		visitor(info.inputAssembly.primitiveRestartEnable);
+
+		visitor(info.vertexInput.vertexBindingDescriptionCount);
+		visitor(info.vertexBindingDescription);
+		visitor(info.vertexInput.vertexAttributeDescriptionCount);
+		visitor(info.vertexAttributeDescriptions);
+
+		visitor(info.viewport);
+		visitor(info.scissor);
+
+		visitor(info.colorBlendAttachments);
+		visitor(info.colorBlending.logicOpEnable);
+		visitor(info.colorBlending.logicOp);
+		visitor(info.colorBlending.blendConstants);
+
+		visitor(info.rasterizer.depthClampEnable);
+		visitor(info.rasterizer.rasterizerDiscardEnable);
+		visitor(info.rasterizer.polygonMode);
+		visitor(info.rasterizer.cullMode);
+		visitor(info.rasterizer.frontFace);
+		visitor(info.rasterizer.depthBiasEnable);
+		visitor(info.rasterizer.depthBiasConstantFactor);
+		visitor(info.rasterizer.depthBiasClamp);
+		visitor(info.rasterizer.depthBiasSlopeFactor);
+		visitor(info.rasterizer.lineWidth);
+
+		visitor(info.depthStencil.depthTestEnable);
+		visitor(info.depthStencil.depthWriteEnable);
+		visitor(info.depthStencil.depthCompareOp);
+		visitor(info.depthStencil.depthBoundsTestEnable);
+		visitor(info.depthStencil.stencilTestEnable);
+		visitor(info.depthStencil.front);
+		visitor(info.depthStencil.back);
+		visitor(info.depthStencil.minDepthBounds);
+		visitor(info.depthStencil.maxDepthBounds);
+
+		visitor(info.multisampling.sampleShadingEnable);
+		visitor(info.multisampling.minSampleShading);
+		visitor(info.multisampling.alphaToCoverageEnable);
+		visitor(info.multisampling.alphaToOneEnable);
+
+		visitor(info.tesselation.patchControlPoints);
+		visitor(info.dynamicStateList);
+
+		visitor(info.bindless);
+	}
+}
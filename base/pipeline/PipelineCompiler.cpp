@@ -0,0 +1,243 @@
+#include "PipelineCompiler.h"
+
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "../VulkanDevice.h"
+#include "../VulkanMaterial.h"
+#include "../VulkanPipelineCache.h"
+#include "PipelineRegistry.h"
+
+namespace vku {
+	PipelineCompiler::PipelineCompiler(VulkanDevice* device, uint32_t threadCount) {
+		this->device = device;
+
+		if (threadCount == 0) {
+			threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		}
+
+		// start the workers off with what the last run left in the device cache
+		size_t dataSize = 0;
+		vkGetPipelineCacheData(*device, *device->pipelineCache, &dataSize, nullptr);
+		std::vector<char> data(dataSize);
+		if (dataSize > 0 && vkGetPipelineCacheData(*device, *device->pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+			dataSize = 0;
+		}
+
+		workerCaches.resize(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++) {
+			VkPipelineCacheCreateInfo cacheCI{};
+			cacheCI.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+			cacheCI.initialDataSize = dataSize;
+			cacheCI.pInitialData = dataSize > 0 ? data.data() : nullptr;
+			if (vkCreatePipelineCache(*device, &cacheCI, nullptr, &workerCaches[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create pipeline cache for compiler thread!");
+			}
+		}
+		for (uint32_t i = 0; i < threadCount; i++) {
+			workers.push_back(std::thread(&PipelineCompiler::work, this, i));
+		}
+	}
+
+	PipelineCompiler::~PipelineCompiler() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			queue.clear();
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+
+		// so the device cache saves what the workers built
+		try {
+			device->pipelineCache->merge(workerCaches);
+		}
+		catch (const std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+		}
+		for (VkPipelineCache cache : workerCaches) {
+			vkDestroyPipelineCache(*device, cache, nullptr);
+		}
+
+		for (Result& result : completed) {
+			if (result.shared != nullptr) {
+				device->pipelineRegistry->release(result.shared);
+			}
+		}
+	}
+
+	void PipelineCompiler::submit(VulkanMaterial* material) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			for (auto it = completed.begin(); it != completed.end();) {
+				if (it->material == material) {
+					if (it->shared != nullptr) {
+						device->pipelineRegistry->release(it->shared);
+					}
+					it = completed.erase(it);
+				}
+				else {
+					it++;
+				}
+			}
+
+			// a queued build hasn't loaded its shaders yet
+			if (std::find(queue.begin(), queue.end(), material) != queue.end()) {
+				return;
+			}
+			// two workers can't build the same material at once, so the worker requeues it when it's done
+			if (std::find(building.begin(), building.end(), material) != building.end()) {
+				if (std::find(stale.begin(), stale.end(), material) == stale.end()) {
+					stale.push_back(material);
+				}
+				return;
+			}
+			queue.push_back(material);
+		}
+		wake.notify_one();
+	}
+
+	void PipelineCompiler::cancel(VulkanMaterial* material) {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		queue.erase(std::remove(queue.begin(), queue.end(), material), queue.end());
+		// so the build in progress isn't requeued
+		stale.erase(std::remove(stale.begin(), stale.end(), material), stale.end());
+		while (std::find(building.begin(), building.end(), material) != building.end()) {
+			buildFinished.wait(lock);
+		}
+
+		for (auto it = completed.begin(); it != completed.end();) {
+			if (it->material == material) {
+				if (it->shared != nullptr) {
+					device->pipelineRegistry->release(it->shared);
+				}
+				it = completed.erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+	}
+
+	void PipelineCompiler::finish(VulkanMaterial* material) {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		// a stale build is requeued once it finishes, so look at the queue again after every wait
+		while (true) {
+			auto queued = std::find(queue.begin(), queue.end(), material);
+			if (queued != queue.end()) {
+				// quicker than waiting for its turn
+				queue.erase(queued);
+				lock.unlock();
+				material->use(material->build(*device->pipelineCache));
+				return;
+			}
+			if (std::find(building.begin(), building.end(), material) == building.end()) {
+				break;
+			}
+			buildFinished.wait(lock);
+		}
+
+		auto result = std::find_if(completed.begin(), completed.end(), [material](const Result& result) {
+			return result.material == material;
+		});
+		if (result == completed.end()) {
+			if (!material->ready) {
+				throw std::runtime_error("Failed to build material pipeline!");
+			}
+			return;
+		}
+		SharedPipeline* shared = result->shared;
+		completed.erase(result);
+		lock.unlock();
+
+		if (shared == nullptr) {
+			throw std::runtime_error("Failed to build material pipeline!");
+		}
+		material->use(shared);
+	}
+
+	void PipelineCompiler::publish() {
+		std::vector<Result> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (completed.empty()) {
+				return;
+			}
+			finished.swap(completed);
+		}
+
+		ZoneScopedN("Publish Compiled Pipelines");
+		for (Result& result : finished) {
+			if (result.shared == nullptr) {
+				// build failed, the material keeps drawing with the fallback
+				continue;
+			}
+			result.material->use(result.shared);
+		}
+	}
+
+	void PipelineCompiler::work(uint32_t index) {
+		tracy::SetThreadName("Pipeline Compiler");
+
+		while (true) {
+			VulkanMaterial* material;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				while (queue.empty() && !stopping) {
+					wake.wait(lock);
+				}
+				if (stopping) {
+					break;
+				}
+				material = queue.front();
+				queue.pop_front();
+				building.push_back(material);
+			}
+
+			SharedPipeline* shared = nullptr;
+			{
+				ZoneScopedN("Compile Pipeline");
+				try {
+					shared = material->build(workerCaches[index]);
+				}
+				catch (const std::runtime_error& e) {
+					std::cerr << "Failed to build pipeline asynchronously: " << e.what() << std::endl;
+				}
+			}
+
+			bool requeued = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				building.erase(std::find(building.begin(), building.end(), material));
+
+				auto staleIt = std::find(stale.begin(), stale.end(), material);
+				if (staleIt != stale.end()) {
+					// its shaders were reloaded while it was being built
+					stale.erase(staleIt);
+					if (shared != nullptr) {
+						device->pipelineRegistry->release(shared);
+					}
+					if (!stopping) {
+						queue.push_back(material);
+						requeued = true;
+					}
+				}
+				else {
+					completed.push_back({ material, shared });
+				}
+			}
+			buildFinished.notify_all();
+			if (requeued) {
+				wake.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <vulkan/vulkan.h>
+
+namespace vku {
+	struct VulkanDevice;
+	struct VulkanMaterial;
+	struct SharedPipeline;
+
+	// builds material pipelines on background threads.
+	// finished pipelines are handed to their materials in publish(), which the render loop calls at a frame boundary.
+	// each worker builds into a pipeline cache of its own, so they don't contend on the device's. they are merged into it on destruction.
+	struct PipelineCompiler {
+		VulkanDevice* device;
+
+		// threadCount of 0 uses one less than the hardware threads, leaving one for the render loop
+		PipelineCompiler(VulkanDevice* device, uint32_t threadCount = 0);
+		~PipelineCompiler();
+
+		// queue a material for a build. a material that is being built right now is built again once that finishes,
+		// and anything built for it that hasn't been published yet is dropped, since it may come from old shaders.
+		void submit(VulkanMaterial* material);
+		// forget a material, waiting for its build to finish if it is in progress
+		void cancel(VulkanMaterial* material);
+		// hand a material its pipeline now, for materials needed before the next publish. waits for a build in progress,
+		// and builds it on the calling thread if no worker has picked it up yet. throws if the build failed.
+		void finish(VulkanMaterial* material);
+		// swap finished pipelines into their materials. only call this from the render thread, between frames.
+		void publish();
+
+	private:
+		struct Result {
+			VulkanMaterial* material;
+			SharedPipeline* shared;
+		};
+
+		std::vector<std::thread> workers;
+		// one per worker, seeded with the device cache
+		std::vector<VkPipelineCache> workerCaches;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable buildFinished;
+
+		std::deque<VulkanMaterial*> queue;
+		std::vector<Result> completed;
+		// materials currently being built, one per busy worker
+		std::vector<VulkanMaterial*> building;
+		// materials submitted again while being built, whose current build is thrown away
+		std::vector<VulkanMaterial*> stale;
+		bool stopping = false;
+
+		void work(uint32_t index);
+	};
+}
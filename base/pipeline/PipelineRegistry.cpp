@@ -0,0 +1,170 @@
+#include "PipelineRegistry.h"
+
+#include "../VulkanDevice.h"
+#include "../VulkanMaterial.h"
+#include "../VulkanDescriptorSet.h"
+#include "../util/DeletionQueue.h"
+#include "../shader/ShaderModule.h"
+#include "../shader/ShaderVariant.h"
+#include "MaterialState.h"
+#include "../descriptor/DescriptorLayoutCache.h"
+
+namespace vku {
+	namespace {
+		// appends the raw bytes of plain state
+		struct StateSerializer {
+			std::vector<uint8_t> state;
+
+			void addBytes(const void* data, size_t size) {
+				const uint8_t* bytes = static_cast<const uint8_t*>(data);
+				state.insert(state.end(), bytes, bytes + size);
+			}
+
+			template <typename Type>
+			void add(const Type& value) {
+				addBytes(&value, sizeof(Type));
+			}
+
+			template <typename Type>
+			void add(const std::vector<Type>& values) {
+				add(values.size());
+				if (!values.empty()) {
+					addBytes(values.data(), sizeof(Type) * values.size());
+				}
+			}
+
+			template <typename Type>
+			void operator()(const Type& value) {
+				add(value);
+			}
+		};
+
+		// 64-bit FNV-1a
+		size_t hashBytes(const std::vector<uint8_t>& bytes) {
+			uint64_t hash = 14695981039346656037ull;
+			for (uint8_t byte : bytes) {
+				hash ^= byte;
+				hash *= 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	}
+
+	PipelineKey pipelineStateKey(const VulkanMaterialInfo& info, const std::vector<ShaderModule*>& shaderModules, const std::vector<VkDescriptorSetLayout>& sharedLayouts, const std::vector<DescriptorLayout>& materialDescriptors) {
+		StateSerializer h;
+
+		h.add(info.pipeline.renderPass);
+		h.add(info.pipeline.subpass);
+		h.add(info.multisampling.rasterizationSamples);
+		h.add(info.multisampling.pSampleMask != nullptr ? *info.multisampling.pSampleMask : ~0u);
+
+		for (ShaderModule* module : shaderModules) {
+			h.add(module->handle);
+			h.add(module->shaderStageFlag);
+		}
+		for (const ShaderVariant& stage : info.shaderStages) {
+			h.add(stage.constants.size());
+			for (auto& [name, value] : stage.constants) {
+				h.add(name.size());
+				h.addBytes(name.data(), name.size());
+				h.add(value.bits);
+			}
+		}
+		h.add(sharedLayouts);
+		h.add(materialDescriptors);
+
+		visitMaterialState(info, h);
+
+		PipelineKey key;
+		key.hash = hashBytes(h.state);
+		key.state = std::move(h.state);
+		return key;
+	}
+
+	PipelineRegistry::PipelineRegistry(VulkanDevice* device) {
+		this->device = device;
+	}
+
+	PipelineRegistry::~PipelineRegistry() {
+		// only called once the device is idle
+		for (auto& [key, shared] : pipelines) {
+			vkDestroyPipeline(*device, shared->pipeline, nullptr);
+			releaseLayouts(shared);
+			delete shared;
+		}
+	}
+
+	SharedPipeline* PipelineRegistry::acquire(const PipelineKey& key) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			auto it = pipelines.find(key);
+			if (it != pipelines.end()) {
+				hits++;
+				it->second->refCount++;
+				return it->second;
+			}
+			if (building.find(key) == building.end()) {
+				misses++;
+				building.insert(key);
+				return nullptr;
+			}
+			// eg. warm-up is compiling it in the background; its result will be ours too
+			buildFinished.wait(lock);
+		}
+	}
+
+	SharedPipeline* PipelineRegistry::insert(const PipelineKey& key, VkPipeline pipeline, VkPipelineLayout pipelineLayout, VulkanDescriptorSetLayout* descriptorSetLayout) {
+		std::lock_guard<std::mutex> lock(mutex);
+		building.erase(key);
+		buildFinished.notify_all();
+
+		auto it = pipelines.find(key);
+		if (it != pipelines.end()) {
+			// lost a race against another thread building the same pipeline. ours was never used, so destroy it right away.
+			vkDestroyPipeline(*device, pipeline, nullptr);
+			device->descriptorLayoutCache->releasePipelineLayout(pipelineLayout);
+			device->descriptorLayoutCache->releaseSetLayout(descriptorSetLayout);
+			it->second->refCount++;
+			return it->second;
+		}
+
+		SharedPipeline* shared = new SharedPipeline;
+		shared->key = key;
+		shared->refCount = 1;
+		shared->pipeline = pipeline;
+		shared->pipelineLayout = pipelineLayout;
+		shared->descriptorSetLayout = descriptorSetLayout;
+
+		pipelines[key] = shared;
+		return shared;
+	}
+
+	void PipelineRegistry::abandon(const PipelineKey& key) {
+		std::lock_guard<std::mutex> lock(mutex);
+		building.erase(key);
+		buildFinished.notify_all();
+	}
+
+	void PipelineRegistry::release(SharedPipeline* shared) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--shared->refCount > 0) {
+			return;
+		}
+
+		pipelines.erase(shared->key);
+
+		VkDevice vkDevice = *device;
+		VkPipeline pipeline = shared->pipeline;
+		device->deletionQueue->push([vkDevice, pipeline]() {
+			vkDestroyPipeline(vkDevice, pipeline, nullptr);
+		});
+		releaseLayouts(shared);
+		delete shared;
+	}
+
+	void PipelineRegistry::releaseLayouts(SharedPipeline* shared) {
+		// the cache retires them through the deletion queue too, after the pipeline
+		device->descriptorLayoutCache->releasePipelineLayout(shared->pipelineLayout);
+		device->descriptorLayoutCache->releaseSetLayout(shared->descriptorSetLayout);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+
+#include <vulkan/vulkan.h>
+
+namespace vku {
+	struct VulkanDevice;
+	struct VulkanMaterialInfo;
+	struct VulkanDescriptorSetLayout;
+	struct ShaderModule;
+	struct DescriptorLayout;
+
+	// everything that ends up in a VkPipeline, serialized, and a hash of it.
+	// keys are only equal if all of the state is, so a hash collision can't hand a material someone else's pipeline.
+	struct PipelineKey {
+		size_t hash = 0;
+		std::vector<uint8_t> state;
+
+		bool operator==(const PipelineKey& other) const {
+			return hash == other.hash && state == other.state;
+		}
+	};
+
+	struct PipelineKeyHash {
+		size_t operator()(const PipelineKey& key) const {
+			return key.hash;
+		}
+	};
+
+	// a pipeline shared by every material with identical state
+	struct SharedPipeline {
+		PipelineKey key;
+		uint32_t refCount = 0;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		// references into the device's DescriptorLayoutCache, released with the pipeline.
+		// a shader reload only replaces the VkPipeline, since identical layouts come back from the cache.
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VulkanDescriptorSetLayout* descriptorSetLayout = nullptr;
+	};
+
+	// key of everything that ends up in the VkPipeline: fixed function state, shader modules and specialization constants,
+	// the render pass / subpass, the descriptor set layouts shared with the scene and pass, and the material's own set.
+	PipelineKey pipelineStateKey(const VulkanMaterialInfo& info, const std::vector<ShaderModule*>& shaderModules, const std::vector<VkDescriptorSetLayout>& sharedLayouts, const std::vector<DescriptorLayout>& materialDescriptors);
+
+	// deduplicates pipelines across materials, so byte-identical materials share one VkPipeline.
+	// safe to use from the pipeline compiler thread. unused objects are retired through the device's deletion queue.
+	struct PipelineRegistry {
+		VulkanDevice* device;
+
+		std::unordered_map<PipelineKey, SharedPipeline*, PipelineKeyHash> pipelines;
+
+		// statistics
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+
+		PipelineRegistry(VulkanDevice* device);
+		~PipelineRegistry();
+
+		// returns an existing pipeline with a new reference, or nullptr if none is registered under this key.
+		// nullptr also makes the caller the builder of the key: it must insert() or abandon() it, and until then
+		// other threads acquiring the same key wait for it, rather than compiling the same pipeline twice.
+		SharedPipeline* acquire(const PipelineKey& key);
+		// takes ownership of a freshly built pipeline and the caller's references to its layouts, returning it with one reference.
+		// if the same key was registered in the meantime, the new pipeline is destroyed and the existing one returned.
+		SharedPipeline* insert(const PipelineKey& key, VkPipeline pipeline, VkPipelineLayout pipelineLayout, VulkanDescriptorSetLayout* descriptorSetLayout);
+		// gives up building a key after acquire() returned nullptr, so a waiting thread can try in its place
+		void abandon(const PipelineKey& key);
+		// drops a reference, retiring the pipeline once nobody uses it
+		void release(SharedPipeline* shared);
+
+	private:
+		std::mutex mutex;
+		// keys that a thread got nullptr for from acquire() and is building
+		std::unordered_set<PipelineKey, PipelineKeyHash> building;
+		std::condition_variable buildFinished;
+
+		void releaseLayouts(SharedPipeline* shared);
+	};
+}
@@ -0,0 +1,221 @@
+#include "PipelineUsageLog.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <json.hpp>
+
+#include "MaterialState.h"
+
+using json = nlohmann::json;
+
+namespace vku {
+	namespace {
+		// bumped whenever the meaning of the state blob changes
+		const int USAGE_LOG_VERSION = 3;
+
+		struct StateWriter {
+			std::vector<uint8_t> bytes;
+
+			template <typename Type>
+			void operator()(const Type& value) {
+				const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+				bytes.insert(bytes.end(), data, data + sizeof(Type));
+			}
+
+			template <typename Type>
+			void operator()(const std::vector<Type>& values) {
+				(*this)(static_cast<uint64_t>(values.size()));
+				const uint8_t* data = reinterpret_cast<const uint8_t*>(values.data());
+				bytes.insert(bytes.end(), data, data + sizeof(Type) * values.size());
+			}
+		};
+
+		struct StateReader {
+			const std::vector<uint8_t>& bytes;
+			size_t offset = 0;
+			bool valid = true;
+
+			StateReader(const std::vector<uint8_t>& bytes) : bytes(bytes) {}
+
+			bool read(void* data, size_t size) {
+				if (!valid || bytes.size() - offset < size) {
+					valid = false;
+					return false;
+				}
+				memcpy(data, bytes.data() + offset, size);
+				offset += size;
+				return true;
+			}
+
+			template <typename Type>
+			void operator()(Type& value) {
+				read(&value, sizeof(Type));
+			}
+
+			template <typename Type>
+			void operator()(std::vector<Type>& values) {
+				uint64_t size = 0;
+				if (!read(&size, sizeof(size)) || size > (bytes.size() - offset) / sizeof(Type)) {
+					valid = false;
+					return;
+				}
+				values.resize(static_cast<size_t>(size));
+				read(values.data(), sizeof(Type) * values.size());
+			}
+		};
+
+		std::string toHex(const std::vector<uint8_t>& bytes) {
+			const char* digits = "0123456789abcdef";
+			std::string hex;
+			hex.reserve(bytes.size() * 2);
+			for (uint8_t byte : bytes) {
+				hex.push_back(digits[byte >> 4]);
+				hex.push_back(digits[byte & 0xF]);
+			}
+			return hex;
+		}
+
+		std::vector<uint8_t> fromHex(const std::string& hex) {
+			if (hex.size() % 2 != 0) {
+				throw std::runtime_error("Invalid pipeline state!");
+			}
+			std::vector<uint8_t> bytes(hex.size() / 2);
+			for (size_t i = 0; i < bytes.size(); i++) {
+				bytes[i] = static_cast<uint8_t>(std::stoi(hex.substr(i * 2, 2), nullptr, 16));
+			}
+			return bytes;
+		}
+	}
+
+	PipelineUsageLog::PipelineUsageLog(const std::string& path) {
+		this->path = path;
+		if (path.empty()) {
+			return;
+		}
+
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			return;
+		}
+
+		json log;
+		try {
+			file >> log;
+		}
+		catch (const json::exception& e) {
+			std::cerr << "Ignoring corrupt pipeline usage log '" << path << "'." << std::endl;
+			return;
+		}
+		if (!log.is_object() || log.find("version") == log.end() || log["version"] != USAGE_LOG_VERSION || log.find("pipelines") == log.end()) {
+			std::cout << "Pipeline usage log '" << path << "' is from another version, starting over." << std::endl;
+			return;
+		}
+
+		for (const json& entry : log["pipelines"]) {
+			entries.insert(entry.dump());
+		}
+	}
+
+	PipelineUsageLog::~PipelineUsageLog() {
+		write();
+	}
+
+	void PipelineUsageLog::record(const std::string& pass, const VulkanMaterialInfo& info) {
+		if (path.empty()) {
+			return;
+		}
+
+		StateWriter state;
+		visitMaterialState(info, state);
+		state(info.descriptorLayouts);
+
+		json stages = json::array();
+		for (const ShaderVariant& variant : info.shaderStages) {
+			std::map<std::string, uint32_t> constants;
+			for (auto& [name, value] : variant.constants) {
+				constants[name] = value.bits;
+			}
+			stages.push_back({ { "name", variant.name }, { "macros", variant.macros }, { "constants", constants } });
+		}
+
+		json entry;
+		entry["pass"] = pass;
+		entry["shaderStages"] = stages;
+		entry["state"] = toHex(state.bytes);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (entries.insert(entry.dump()).second) {
+			modified = true;
+		}
+	}
+
+	std::vector<PipelineUsage> PipelineUsageLog::getUsages() {
+		std::vector<std::string> serialized;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			serialized.assign(entries.begin(), entries.end());
+		}
+
+		std::vector<PipelineUsage> usages;
+		for (const std::string& dump : serialized) {
+			PipelineUsage usage;
+			try {
+				json entry = json::parse(dump);
+				usage.pass = entry.at("pass").get<std::string>();
+
+				std::vector<uint8_t> bytes = fromHex(entry.at("state").get<std::string>());
+				StateReader state(bytes);
+				visitMaterialState(usage.info, state);
+				state(usage.info.descriptorLayouts);
+				if (!state.valid || state.offset != bytes.size()) {
+					continue;
+				}
+
+				usage.info.shaderStages.clear();
+				for (const json& stage : entry.at("shaderStages")) {
+					ShaderVariant variant{};
+					variant.name = stage.at("name").get<std::string>();
+					variant.macros = stage.at("macros").get<std::map<std::string, std::string>>();
+					for (auto& [name, bits] : stage.at("constants").get<std::map<std::string, uint32_t>>()) {
+						variant.constants[name] = bits;
+					}
+					usage.info.shaderStages.push_back(variant);
+				}
+			}
+			catch (const std::exception& e) {
+				// written by an incompatible build
+				continue;
+			}
+
+			usage.info.linkPointers();
+			usages.push_back(usage);
+		}
+		return usages;
+	}
+
+	void PipelineUsageLog::write() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (path.empty() || !modified) {
+			return;
+		}
+
+		json pipelines = json::array();
+		for (const std::string& dump : entries) {
+			pipelines.push_back(json::parse(dump));
+		}
+		json log;
+		log["version"] = USAGE_LOG_VERSION;
+		log["pipelines"] = pipelines;
+
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			std::cerr << "Failed to open '" << path << "' for writing." << std::endl;
+			return;
+		}
+		file << log.dump(1, '\t') << std::endl;
+		modified = false;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+
+#include "../VulkanMaterial.h"
+
+namespace vku {
+	// a material pipeline built in an earlier session, and the render graph pass it was built for
+	struct PipelineUsage {
+		std::string pass;
+		VulkanMaterialInfo info;
+	};
+
+	// remembers every material pipeline created, across sessions, so later launches can build them before they're needed.
+	// stored as json; the material state itself is an opaque blob that is only valid for the build that wrote it.
+	struct PipelineUsageLog {
+		// empty disables the log
+		std::string path;
+
+		// loads the entries of previous sessions
+		PipelineUsageLog(const std::string& path);
+		// merges this session's pipelines into the log on disk
+		~PipelineUsageLog();
+
+		// thread safe
+		void record(const std::string& pass, const VulkanMaterialInfo& info);
+		// every pipeline in the log, including those recorded this session
+		std::vector<PipelineUsage> getUsages();
+
+		void write();
+
+	private:
+		std::mutex mutex;
+		// one json object per pipeline, so duplicates collapse
+		std::set<std::string> entries;
+		bool modified = false;
+	};
+}
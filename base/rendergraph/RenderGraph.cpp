@@ -1,11 +1,14 @@
 #include <TracyVulkan.hpp>
+#include <Tracy.hpp>
 
 #include "VulkanContext.h"
 
 #include "RenderGraph.h"
 #include "../scene/Scene.h"
+#include "../scene/ObjectBuffer.h"
 
 #include <stdexcept>
+#include <iostream>
 
 #include <glm/glm.hpp>
 
@@ -16,6 +19,9 @@
 #include "VulkanMaterial.h"
 #include "VulkanMesh.h"
 #include "shader/ShaderVariant.h"
+#include "pipeline/PipelineUsageLog.h"
+#include "descriptor/DescriptorWriter.h"
+#include "descriptor/DescriptorLayoutCache.h"
 
 namespace vku {
 	PassAttachmentRead* PassSchema::read(size_t slot, AttachmentSchema* in, PassReadOptions options) {
@@ -69,6 +75,7 @@ namespace vku {
 		this->device = scene->device;
 		this->numInstances = numInstances;
 		this->schema = schema;
+		this->recordedGenerations.resize(numInstances, 0);
 
 		// allocate passes and attachments
 		nodes.resize(schema->nodes.size());
@@ -409,7 +416,7 @@ namespace vku {
 						.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 						.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT });
 				}
-				passNode->inputLayout = new VulkanDescriptorSetLayout(device, layouts);
+				passNode->inputLayout = device->descriptorLayoutCache->acquireSetLayout(layouts);
 			}
 			// generate one pipeline layout for each node (must be a subset of all pipeline layouts hereafter)
 			{
@@ -423,17 +430,7 @@ namespace vku {
 				maxPushConst.offset = 0;
 				maxPushConst.size = 128;
 
-				VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-				pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-				pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
-				pipelineLayoutInfo.pSetLayouts = layouts.data();
-				pipelineLayoutInfo.pushConstantRangeCount = 1;
-				pipelineLayoutInfo.pPushConstantRanges = &maxPushConst;
-
-				VkResult result = vkCreatePipelineLayout(*device, &pipelineLayoutInfo, nullptr, &passNode->pipelineLayout);
-				if (result != VK_SUCCESS) {
-					throw std::runtime_error("Failed to create pipeline layout for material!");
-				}
+				passNode->pipelineLayout = device->descriptorLayoutCache->acquirePipelineLayout(layouts, { maxPushConst });
 			}
 			// generate one material automatically, if it's a blitPass
 			if (schema.isBlitPass) {
@@ -448,17 +445,42 @@ namespace vku {
 				passNode->materialInstance = new VulkanMaterialInstance(passNode->material);
 			}
 		}
+
+		warmUpPipelines();
+	}
+
+	void RenderGraph::warmUpPipelines() {
+		ZoneScopedN("Pipeline Warm-up");
+
+		// built asynchronously; the registry hands the finished pipelines to the scene's identical materials
+		for (PipelineUsage& usage : device->pipelineUsageLog->getUsages()) {
+			Pass* pass = getPass(usage.pass);
+			if (pass == nullptr) {
+				continue;
+			}
+			try {
+				warmMaterials.push_back(new VulkanMaterial(&usage.info, scene, pass, true));
+			}
+			catch (const std::runtime_error& e) {
+				std::cerr << "Skipping pipeline warm-up for pass '" << usage.pass << "': " << e.what() << std::endl;
+			}
+		}
 	}
+
 	void RenderGraph::destroyLayouts() {
 		if (blitMesh != nullptr)
 			delete blitMesh;
+		for (VulkanMaterial* material : warmMaterials) {
+			delete material;
+		}
+		warmMaterials.clear();
 		for (Pass* node : nodes) {
 			if (node->schema->isBlitPass || node->schema->materialOverride) {
 				delete node->materialInstance;
 				delete node->material;
 			}
-			vkDestroyPipelineLayout(*device, node->pipelineLayout, nullptr);
-			delete node->inputLayout;
+			device->descriptorLayoutCache->releasePipelineLayout(node->pipelineLayout);
+			device->descriptorLayoutCache->releaseSetLayout(node->inputLayout);
 			vkDestroyRenderPass(*device, node->pass, nullptr);
 		}
 	}
@@ -527,6 +549,7 @@ namespace vku {
 					imageInfo.numSamples = schema->samples;
 					imageInfo.format = schema->format;
 					imageInfo.usage = usage;
+					imageInfo.category = MemoryCategory::Attachment;
 
 					VulkanImageViewInfo imageViewInfo{};
 					imageViewInfo.aspectFlags = aspect;
@@ -629,20 +652,22 @@ namespace vku {
 		}
 
 		// Now that all nodes have allocated their descriptor sets, let's write input image references to them
+		DescriptorWriter writer(device);
 		for (uint32_t i = 0; i < numInstances; i++) {
 			for (Pass* node : nodes) {
 				int k = 0;
 				for (Attachment* edge : node->in) {
 					if (edge->schema->resolve) {
-						node->instances[i].descriptorSet->write(k, edge->resolveInstances[i].texture);
+						writer.write(node->instances[i].descriptorSet, k, edge->resolveInstances[i].texture);
 					}
 					else {
-						node->instances[i].descriptorSet->write(k, edge->instances[i].texture);
+						writer.write(node->instances[i].descriptorSet, k, edge->instances[i].texture);
 					}
 					++k;
 				}
 			}
 		}
+		writer.flush();
 	}
 
 	void RenderGraph::destroyInstances() {
@@ -662,6 +687,10 @@ namespace vku {
 	}
 
 
+	bool RenderGraph::needsRecording(uint32_t i) const {
+		return recordedGenerations[i] != device->pipelineGeneration;
+	}
+
 	void RenderGraph::render(VkCommandBuffer cmdbuf, uint32_t i) {
 		// we'll set width/height in the loop
 		VkViewport viewport{};
@@ -672,9 +701,41 @@ namespace vku {
 		VkRect2D scissor{};
 		scissor.offset = { 0,0 };
 
-		vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->globalPipelineLayout, 0, 1, &scene->globalDescriptorSets[i]->handle, 0, nullptr);
+		recordedGenerations[i] = device->pipelineGeneration;
+
+		// per-object data has to land before any pass reads it
+		scene->objectBuffer->recordUpload(cmdbuf, i);
+
+		// bound state carries over from pass to pass, so one recorder sees the whole command buffer
+		CommandRecorder recorder(cmdbuf);
+
+		// culled passes draw whatever this frame's cull dispatch leaves in the indirect buffers
+		Pass* cullingDepthPass = nullptr;
+		Attachment* cullingDepth = nullptr;
+		if (scene->gpuCulling != nullptr) {
+			for (Pass* node : nodes) {
+				if (!node->schema->gpuCulled) {
+					continue;
+				}
+				for (uint32_t k = 0; k < node->out.size(); k++) {
+					if (node->out[k]->schema->isDepth && node->schema->out[k].options.sampled) {
+						cullingDepthPass = node;
+						cullingDepth = node->out[k];
+					}
+				}
+				break;
+			}
+		}
+		if (cullingDepth != nullptr) {
+			scene->gpuCulling->beginRecording(i, cullingDepth->instances[i].texture, cullingDepth->width, cullingDepth->height);
+			scene->gpuCulling->recordCull(recorder, i);
+		}
+
+		scene->bind(recorder, i);
 
 		for (auto& node : nodes) {
+			CommandRecorderStats statsBefore = recorder.stats;
+
 			std::vector<VkClearValue> clearValues{};
 			for (PassAttachmentRead edge : node->schema->in) {
 				if (edge.attachment->isDepth) {
@@ -698,8 +759,8 @@ namespace vku {
 			viewport.width = width;
 			viewport.height = height;
 			scissor.extent = { width,height };
-			vkCmdSetViewport(cmdbuf, 0, 1, &viewport);
-			vkCmdSetScissor(cmdbuf, 0, 1, &scissor);
+			recorder.setViewport(viewport);
+			recorder.setScissor(scissor);
 
 			VkRenderPassBeginInfo passBeginInfo{};
 			passBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -726,7 +787,7 @@ namespace vku {
 				}
 			}
 
-			vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_GRAPHICS, node->pipelineLayout, 1, 1, &node->instances[i].descriptorSet->handle, 0, nullptr);
+			recorder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, node->pipelineLayout, 1, 1, &node->instances[i].descriptorSet->handle);
 
 			// mark the GPU zone for profiling
 #ifdef TRACY_ENABLE
@@ -736,19 +797,21 @@ namespace vku {
 			vkCmdBeginRenderPass(cmdbuf, &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 			{
 				if (node->schema->isBlitPass) {
-					node->material->bind(cmdbuf);
-					node->materialInstance->bind(cmdbuf, i);
-					blitMesh->draw(cmdbuf);
+					node->material->bind(recorder);
+					node->materialInstance->bind(recorder, i);
+					blitMesh->draw(recorder);
 				}
 				else if (node->schema->materialOverride) {
-					node->material->bind(cmdbuf);
-					node->materialInstance->bind(cmdbuf, i);
+					node->material->bind(recorder);
+					node->materialInstance->bind(recorder, i);
 				}
 
-				scene->render(cmdbuf, i, node->schema->materialOverride, node->schema->layerMask);
+				scene->render(recorder, i, node->schema->materialOverride, node->schema->layerMask, cullingDepth != nullptr && node->schema->gpuCulled);
 			}
 			vkCmdEndRenderPass(cmdbuf);
 
+			node->recorderStats = recorder.stats - statsBefore;
+
 			// update layout state for implicit render pass stuff
 			for (uint32_t k = 0; k < node->schema->out.size(); k++) {
 				const auto& attachment = node->schema->out[k];
@@ -756,8 +819,16 @@ namespace vku {
 					node->out[k]->instances[i].currentLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 				}
 			}
+
+			if (node == cullingDepthPass) {
+				scene->gpuCulling->recordDepthPyramid(recorder, i);
+			}
 		}
 
+		recorderStats = recorder.stats;
+		TracyPlot("Recorded State Changes", static_cast<int64_t>(recorderStats.issued()));
+		TracyPlot("Elided State Changes", static_cast<int64_t>(recorderStats.elided()));
+
 		TracyVkCollect(device->context->tracyContext, cmdbuf);
 	}
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "VulkanTexture.h"
 #include "shader/ShaderVariant.h"
 #include "VulkanMaterial.h"
+#include "CommandRecorder.h"
 
 namespace vku {
 
@@ -67,6 +68,10 @@ namespace vku {
 		bool isBlitPass = false;
 		VulkanMaterialInfo blitPassMaterialInfo;
 
+		// sorted draws are culled on the GPU, if the scene has a GpuCulling. the first such pass must write a sampled depth
+		// attachment; the next frame's occlusion test reads a pyramid built from it. otherwise the pass is drawn as usual.
+		bool gpuCulled = false;
+
 		PassSchema(const std::string name) {
 			this->name = name;
 #ifdef TRACY_ENABLE
@@ -160,6 +165,10 @@ namespace vku {
 		VulkanMaterial* material = nullptr;
 		VulkanMaterialInstance* materialInstance = nullptr;
 
+		// cheap material drawn in place of any material in this pass whose pipeline is still compiling.
+		// if null, those draws are skipped.
+		VulkanMaterialInstance* fallbackMaterial = nullptr;
+
 		const PassSchema* schema;
 
 		VkRenderPass pass;
@@ -167,6 +176,9 @@ namespace vku {
 		VkPipelineLayout pipelineLayout;
 
 		std::vector<PassInstance> instances;
+
+		// what recording this pass last bound, and what it skipped as already bound
+		CommandRecorderStats recorderStats;
 	};
 
 	struct Attachment {
@@ -192,9 +204,20 @@ namespace vku {
 		// multiple instances for swap synchronization purposes
 		uint32_t numInstances;
 
+		// the device's pipelineGeneration when each instance was last rendered
+		std::vector<uint64_t> recordedGenerations;
+
+		// materials built from the pipeline usage log, so their pipelines exist before the scene asks for them
+		std::vector<VulkanMaterial*> warmMaterials;
+
+		void warmUpPipelines();
+
 	public:
 		VulkanMeshBuffer* blitMesh = nullptr;
 
+		// totals of the last render, over all passes
+		CommandRecorderStats recorderStats;
+
 		RenderGraph(RenderGraphSchema* schema, Scene* scene, uint32_t numInstances);
 		~RenderGraph();
 
@@ -202,6 +225,9 @@ namespace vku {
 		Attachment* getAttachment(const std::string& name);
 
 		void render(VkCommandBuffer cmdbuf, uint32_t i);
+		// whether a material changed pipelines since instance i was last rendered. command buffers that are recorded
+		// once and submitted many times must be recorded again before their next submit, as the old pipeline gets retired.
+		bool needsRecording(uint32_t i) const;
 
 		void createLayouts();
 		void destroyLayouts();
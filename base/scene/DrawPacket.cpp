@@ -0,0 +1,66 @@
+#include "DrawPacket.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace vku {
+	namespace DrawKey {
+		static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64, "Draw key fields must fill 64 bits");
+
+		static uint64_t field(uint32_t value, uint32_t bits) {
+			// ids past the field's range share its last value. that only costs sort quality, the binds are still correct.
+			uint64_t max = (1ull << bits) - 1;
+			return std::min<uint64_t>(value, max);
+		}
+
+		uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth) {
+			uint64_t key = field(pass, PASS_BITS);
+			key = (key << PIPELINE_BITS) | field(pipeline, PIPELINE_BITS);
+			key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+			key = (key << MESH_BITS) | field(mesh, MESH_BITS);
+			key = (key << DEPTH_BITS) | field(depth, DEPTH_BITS);
+			return key;
+		}
+
+		uint32_t depth(float distance) {
+			// the bits of a non-negative float sort like the float itself. keep the exponent and the top of the mantissa.
+			uint32_t bits;
+			memcpy(&bits, &distance, sizeof(float));
+			return bits >> (32 - DEPTH_BITS);
+		}
+	}
+
+	void radixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch) {
+		if (packets.size() < 2) {
+			return;
+		}
+
+		// bits that differ between any two keys
+		uint64_t varying = 0;
+		for (const DrawPacket& packet : packets) {
+			varying |= packet.key ^ packets[0].key;
+		}
+
+		scratch.resize(packets.size());
+		for (uint32_t shift = 0; shift < 64; shift += 8) {
+			if (((varying >> shift) & 0xFF) == 0) {
+				continue;
+			}
+
+			size_t offsets[256] = {};
+			for (const DrawPacket& packet : packets) {
+				offsets[(packet.key >> shift) & 0xFF]++;
+			}
+			size_t total = 0;
+			for (size_t& offset : offsets) {
+				size_t count = offset;
+				offset = total;
+				total += count;
+			}
+			for (const DrawPacket& packet : packets) {
+				scratch[offsets[(packet.key >> shift) & 0xFF]++] = packet;
+			}
+			packets.swap(scratch);
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vku {
+	struct VulkanMaterialInstance;
+
+	// one indexed draw, as handed to Scene::render by objects that support sorted submission
+	struct DrawPacket {
+		// filled in by the scene. from the most significant bits: pass, pipeline, material, mesh, depth.
+		uint64_t key;
+
+		// unresolved; the scene resolves it, and ignores it in passes drawn without materials
+		VulkanMaterialInstance* materialInstance;
+
+		// usually a GeometryBuffer arena, shared with other meshes
+		VkBuffer vertexBuffer;
+		VkBuffer indexBuffer;
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+
+		// entry in the scene's ObjectBuffer
+		uint32_t objectIndex;
+	};
+
+	// bit widths of the sort key fields
+	namespace DrawKey {
+		const uint32_t PASS_BITS = 8;
+		const uint32_t PIPELINE_BITS = 12;
+		const uint32_t MATERIAL_BITS = 12;
+		const uint32_t MESH_BITS = 12;
+		const uint32_t DEPTH_BITS = 20;
+
+		uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth);
+		// monotonic in the distance, for non-negative distances
+		uint32_t depth(float distance);
+	}
+
+	// stable LSD radix sort by key, 8 bits at a time. scratch is just reused memory.
+	// byte positions where every key agrees are skipped, so keys that only differ in a few fields sort quickly.
+	void radixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+}
@@ -0,0 +1,391 @@
+#include "GpuCulling.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+#include "../VulkanDevice.h"
+#include "../VulkanSwapchain.h"
+#include "../VulkanTexture.h"
+#include "../VulkanDescriptorSet.h"
+#include "../VulkanPipelineCache.h"
+#include "../UniformRing.h"
+#include "../SamplerCache.h"
+#include "../util/DeletionQueue.h"
+#include "../descriptor/DescriptorWriter.h"
+#include "../descriptor/DescriptorLayoutCache.h"
+#include "../shader/ShaderCache.h"
+#include "../shader/ShaderModule.h"
+#include "Scene.h"
+#include "ObjectBuffer.h"
+
+namespace vku {
+	GpuCulling::GpuCulling(Scene* scene, GpuCullingInfo info) {
+		this->device = scene->device;
+		this->scene = scene;
+		this->info = info;
+
+		if (!supported(device)) {
+			throw std::runtime_error("GPU culling needs drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance!");
+		}
+
+		cullSetLayout = device->descriptorLayoutCache->acquireSetLayout({
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT }
+		});
+		cullPipelineLayout = device->descriptorLayoutCache->acquirePipelineLayout({ cullSetLayout->handle }, {});
+		cullPipeline = createPipeline("scene/cull.comp", cullPipelineLayout);
+
+		pyramidSetLayout = device->descriptorLayoutCache->acquireSetLayout({
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT }
+		});
+		{
+			// source and destination size
+			VkPushConstantRange range{};
+			range.offset = 0;
+			range.size = sizeof(glm::ivec4);
+			range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+			pyramidPipelineLayout = device->descriptorLayoutCache->acquirePipelineLayout({ pyramidSetLayout->handle }, { range });
+		}
+		pyramidPipeline = createPipeline("scene/depth_pyramid.comp", pyramidPipelineLayout);
+
+		// the shaders fetch exact texels, and pick their own mips
+		VulkanSamplerInfo samplerInfo{};
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.maxLod = 16.0f;
+		pyramidSampler = device->samplerCache->get(samplerInfo);
+
+		uniformOffset = device->uniformRing->reserve(sizeof(GpuCullingUniform));
+
+		uint32_t n = device->swapchain->swapChainLength;
+		recordBuffers.resize(n);
+		recordAllocations.resize(n);
+		commandBuffers.resize(n);
+		commandAllocations.resize(n);
+		countBuffers.resize(n);
+		countAllocations.resize(n);
+		drawCounts.resize(n, 0);
+		batchCounts.resize(n, 0);
+		cullSets.resize(n);
+		depthSets.resize(n);
+
+		VkDeviceSize recordsSize = RECORD_HEADER_SIZE + sizeof(GpuDrawRecord) * info.maxDraws;
+		VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * info.maxDraws;
+		VkDeviceSize countsSize = sizeof(uint32_t) * info.maxBatches;
+
+		DescriptorWriter writer(device);
+		for (uint32_t i = 0; i < n; i++) {
+			// written while recording, and mapped for the lifetime of the buffer
+			device->createBuffer(recordsSize,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				recordBuffers[i], recordAllocations[i], MemoryCategory::Storage);
+			*static_cast<uint32_t*>(recordAllocations[i].mapped) = 0;
+
+			device->createBuffer(commandsSize,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				commandBuffers[i], commandAllocations[i], MemoryCategory::Storage);
+			device->createBuffer(countsSize,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				countBuffers[i], countAllocations[i], MemoryCategory::Storage);
+
+			cullSets[i] = new VulkanDescriptorSet(cullSetLayout);
+			depthSets[i] = new VulkanDescriptorSet(pyramidSetLayout);
+
+			// the pyramid is only written once there is one, in beginRecording
+			writer.write(cullSets[i], 0, device->uniformRing->buffer, sizeof(GpuCullingUniform), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+			writer.write(cullSets[i], 1, scene->objectBuffer->buffers[i], scene->objectBuffer->size());
+			writer.write(cullSets[i], 2, recordBuffers[i], recordsSize);
+			writer.write(cullSets[i], 3, commandBuffers[i], commandsSize);
+			writer.write(cullSets[i], 4, countBuffers[i], countsSize);
+		}
+		writer.flush();
+	}
+
+	GpuCulling::~GpuCulling() {
+		destroyPyramid();
+
+		for (uint32_t i = 0; i < cullSets.size(); i++) {
+			delete cullSets[i];
+			delete depthSets[i];
+			device->destroyBuffer(recordBuffers[i], recordAllocations[i]);
+			device->destroyBuffer(commandBuffers[i], commandAllocations[i]);
+			device->destroyBuffer(countBuffers[i], countAllocations[i]);
+		}
+		device->uniformRing->release(uniformOffset, sizeof(GpuCullingUniform));
+
+		// a frame in flight may still dispatch them
+		VkDevice vkDevice = *device;
+		VkPipeline retiredCull = cullPipeline, retiredPyramid = pyramidPipeline;
+		device->deletionQueue->push([vkDevice, retiredCull, retiredPyramid]() {
+			vkDestroyPipeline(vkDevice, retiredCull, nullptr);
+			vkDestroyPipeline(vkDevice, retiredPyramid, nullptr);
+		});
+		device->descriptorLayoutCache->releasePipelineLayout(cullPipelineLayout);
+		device->descriptorLayoutCache->releasePipelineLayout(pyramidPipelineLayout);
+		device->descriptorLayoutCache->releaseSetLayout(cullSetLayout);
+		device->descriptorLayoutCache->releaseSetLayout(pyramidSetLayout);
+	}
+
+	bool GpuCulling::supported(VulkanDevice* device) {
+		return device->supportInfo.gpuDrivenSupported;
+	}
+
+	void GpuCulling::update(uint32_t swapIdx, const glm::mat4& view, const glm::mat4& proj) {
+		GpuCullingUniform uniform{};
+		uniform.viewProj = proj * view;
+		uniform.prevViewProj = prevViewProj;
+
+		// each plane is a sum or difference of rows of the view projection matrix (Gribb & Hartmann), for zero to one depth
+		glm::mat4 rows = glm::transpose(uniform.viewProj);
+		uniform.frustumPlanes[0] = rows[3] + rows[0];
+		uniform.frustumPlanes[1] = rows[3] - rows[0];
+		uniform.frustumPlanes[2] = rows[3] + rows[1];
+		uniform.frustumPlanes[3] = rows[3] - rows[1];
+		uniform.frustumPlanes[4] = rows[2];
+		uniform.frustumPlanes[5] = rows[3] - rows[2];
+		for (glm::vec4& plane : uniform.frustumPlanes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+
+		// a fresh pyramid is cleared to the far plane, so it never culls anything it wasn't built for
+		if (pyramid != nullptr) {
+			uniform.pyramidSize = glm::vec2(pyramidWidth(0), pyramidHeight(0));
+		}
+		uniform.occlusion = info.occlusion && pyramid != nullptr;
+
+		memcpy(device->uniformRing->get(swapIdx, uniformOffset).data, &uniform, sizeof(uniform));
+		prevViewProj = uniform.viewProj;
+	}
+
+	void GpuCulling::beginRecording(uint32_t swapIdx, VulkanTexture* depth, uint32_t width, uint32_t height) {
+		if (pyramid == nullptr || width != depthWidth || height != depthHeight) {
+			createPyramid(width, height);
+		}
+
+		drawCounts[swapIdx] = 0;
+		batchCounts[swapIdx] = 0;
+		*static_cast<uint32_t*>(recordAllocations[swapIdx].mapped) = 0;
+
+		// attachments are recreated with the swapchain, and the pyramid with them, so these are written on every recording
+		DescriptorWriter writer(device);
+		writer.write(cullSets[swapIdx], 5, *pyramidView, VK_IMAGE_LAYOUT_GENERAL, *pyramidSampler);
+		writer.write(depthSets[swapIdx], 0, *depth->view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, *pyramidSampler);
+		writer.write(depthSets[swapIdx], 1, *pyramidMipViews[0], VK_IMAGE_LAYOUT_GENERAL);
+		writer.flush();
+	}
+
+	void GpuCulling::recordCull(CommandRecorder& recorder, uint32_t swapIdx) {
+		vkCmdFillBuffer(recorder, countBuffers[swapIdx], 0, VK_WHOLE_SIZE, 0);
+
+		// the counts are reset, and the previous frame is done reducing the pyramid
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(recorder,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		uint32_t dynamicOffset = device->uniformRing->get(swapIdx, uniformOffset).offset;
+		recorder.bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		recorder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullSets[swapIdx]->handle, 1, &dynamicOffset);
+		// records are only known once the passes are recorded, so the dispatch covers all of them; the shader stops at the count
+		vkCmdDispatch(recorder, (info.maxDraws + 63) / 64, 1, 1);
+
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(recorder,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	bool GpuCulling::drawBatch(CommandRecorder& recorder, uint32_t swapIdx, const DrawPacket* packets, uint32_t count) {
+		uint32_t& draws = drawCounts[swapIdx];
+		uint32_t& batches = batchCounts[swapIdx];
+		if (draws + count > info.maxDraws || batches >= info.maxBatches) {
+			return false;
+		}
+
+		uint8_t* mapped = static_cast<uint8_t*>(recordAllocations[swapIdx].mapped);
+		GpuDrawRecord* records = reinterpret_cast<GpuDrawRecord*>(mapped + RECORD_HEADER_SIZE);
+		for (uint32_t k = 0; k < count; k++) {
+			const DrawPacket& packet = packets[k];
+			records[draws + k] = { packet.indexCount, packet.firstIndex, packet.vertexOffset, packet.objectIndex, batches, draws };
+		}
+
+		// the batch's commands mirror its records, so there is room for all of them to survive.
+		// the object index reaches the shaders as the first instance, and the pushed one only matters to direct draws.
+		scene->pushObjectIndex(recorder, 0);
+		recorder.drawIndexedIndirectCount(
+			commandBuffers[swapIdx], sizeof(VkDrawIndexedIndirectCommand) * draws,
+			countBuffers[swapIdx], sizeof(uint32_t) * batches,
+			count, sizeof(VkDrawIndexedIndirectCommand));
+
+		draws += count;
+		batches++;
+		*reinterpret_cast<uint32_t*>(mapped) = draws;
+
+		recordedDraws = draws;
+		recordedBatches = batches;
+		return true;
+	}
+
+	void GpuCulling::recordDepthPyramid(CommandRecorder& recorder, uint32_t swapIdx) {
+		if (!info.occlusion) {
+			return;
+		}
+
+		// the depth attachment is written, and this frame's cull is done reading the pyramid
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(recorder,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		recorder.bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipeline);
+		for (uint32_t mip = 0; mip < pyramidMipViews.size(); mip++) {
+			VulkanDescriptorSet* set = mip == 0 ? depthSets[swapIdx] : mipSets[mip];
+			recorder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_COMPUTE, pyramidPipelineLayout, 0, 1, &set->handle);
+
+			glm::ivec4 sizes;
+			if (mip == 0) {
+				sizes = glm::ivec4(depthWidth, depthHeight, pyramidWidth(0), pyramidHeight(0));
+			}
+			else {
+				sizes = glm::ivec4(pyramidWidth(mip - 1), pyramidHeight(mip - 1), pyramidWidth(mip), pyramidHeight(mip));
+			}
+			recorder.pushConstants(pyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), &sizes);
+			vkCmdDispatch(recorder, (sizes.z + 7) / 8, (sizes.w + 7) / 8, 1);
+
+			// the next mip is reduced from this one
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(recorder,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+	}
+
+	VkPipeline GpuCulling::createPipeline(const char* shader, VkPipelineLayout layout) {
+		VkComputePipelineCreateInfo pipelineCI{};
+		pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineCI.stage = device->shaderCache->get(shader)->getStageInfo();
+		pipelineCI.layout = layout;
+
+		VkPipeline pipeline;
+		if (vkCreateComputePipelines(*device, *device->pipelineCache, 1, &pipelineCI, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute pipeline!");
+		}
+		return pipeline;
+	}
+
+	void GpuCulling::createPyramid(uint32_t width, uint32_t height) {
+		// the largest power of two that fits, so every mip is exactly half the one above it
+		uint32_t baseWidth = 1, baseHeight = 1;
+		while (baseWidth * 2 <= width) {
+			baseWidth *= 2;
+		}
+		while (baseHeight * 2 <= height) {
+			baseHeight *= 2;
+		}
+		uint32_t mips = 1;
+		while ((std::max(baseWidth, baseHeight) >> mips) > 0) {
+			mips++;
+		}
+
+		VulkanImageInfo imageInfo{};
+		imageInfo.width = baseWidth;
+		imageInfo.height = baseHeight;
+		imageInfo.mipLevels = mips;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		imageInfo.category = MemoryCategory::Attachment;
+		VulkanImage* newPyramid = new VulkanImage(device, imageInfo);
+
+		// it stays in GENERAL, since mips are read and written in turn. clearing it to the far plane makes it cull nothing.
+		{
+			VkCommandBuffer cmdbuf = device->beginCommandBuffer(true);
+
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = *newPyramid;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mips, 0, 1 };
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			VkClearColorValue farPlane = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+			vkCmdClearColorImage(cmdbuf, *newPyramid, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &barrier.subresourceRange);
+
+			// waits for the queue to go idle, so the old pyramid is no longer in use either
+			device->submitCommandBuffer(cmdbuf, device->graphicsQueue);
+		}
+
+		destroyPyramid();
+		pyramid = newPyramid;
+		depthWidth = width;
+		depthHeight = height;
+
+		VulkanImageViewInfo viewInfo{};
+		pyramid->writeImageViewInfo(&viewInfo);
+		pyramidView = new VulkanImageView(device, viewInfo);
+		viewInfo.mipLevels = 1;
+		for (uint32_t mip = 0; mip < mips; mip++) {
+			viewInfo.baseMipLevel = mip;
+			pyramidMipViews.push_back(new VulkanImageView(device, viewInfo));
+		}
+
+		DescriptorWriter writer(device);
+		mipSets.resize(mips, nullptr);
+		for (uint32_t mip = 1; mip < mips; mip++) {
+			mipSets[mip] = new VulkanDescriptorSet(pyramidSetLayout);
+			writer.write(mipSets[mip], 0, *pyramidMipViews[mip - 1], VK_IMAGE_LAYOUT_GENERAL, *pyramidSampler);
+			writer.write(mipSets[mip], 1, *pyramidMipViews[mip], VK_IMAGE_LAYOUT_GENERAL);
+		}
+		writer.flush();
+	}
+
+	void GpuCulling::destroyPyramid() {
+		for (VulkanDescriptorSet* set : mipSets) {
+			delete set;
+		}
+		mipSets.clear();
+		for (VulkanImageView* view : pyramidMipViews) {
+			delete view;
+		}
+		pyramidMipViews.clear();
+		delete pyramidView;
+		pyramidView = nullptr;
+		delete pyramid;
+		pyramid = nullptr;
+	}
+
+	uint32_t GpuCulling::pyramidWidth(uint32_t mip) const {
+		return std::max(pyramid->getInfo().width >> mip, 1u);
+	}
+
+	uint32_t GpuCulling::pyramidHeight(uint32_t mip) const {
+		return std::max(pyramid->getInfo().height >> mip, 1u);
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "../memory/MemoryAllocator.h"
+#include "../CommandRecorder.h"
+#include "DrawPacket.h"
+
+namespace vku {
+	struct VulkanDevice;
+	struct VulkanImage;
+	struct VulkanImageView;
+	struct VulkanSampler;
+	struct VulkanTexture;
+	struct VulkanDescriptorSet;
+	struct VulkanDescriptorSetLayout;
+	struct Scene;
+
+	struct GpuCullingInfo {
+		// draw records per swapchain image. runs of packets past this are drawn on the CPU as usual.
+		uint32_t maxDraws = 16384;
+		// indirect draws per swapchain image, one per run of packets sharing a material and buffers
+		uint32_t maxBatches = 1024;
+		// also test against a depth pyramid built from the previous frame, not just the frustum
+		bool occlusion = true;
+	};
+
+	// one draw for the cull shader to test. matches DrawRecord in shaders/scene/cull.comp (std430).
+	struct GpuDrawRecord {
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t objectIndex;
+		// its counter in the count buffer
+		uint32_t batch;
+		// the first command of its batch's range in the command buffer
+		uint32_t outputOffset;
+	};
+	static_assert(sizeof(GpuDrawRecord) == 24, "GpuDrawRecord must match its std430 layout");
+
+	// matches CullingUniform in shaders/scene/cull.comp (std140)
+	struct GpuCullingUniform {
+		glm::mat4 viewProj;
+		// what the depth pyramid was rendered with
+		glm::mat4 prevViewProj;
+		// world space, pointing inwards
+		glm::vec4 frustumPlanes[6];
+		glm::vec2 pyramidSize;
+		uint32_t occlusion;
+		uint32_t padding;
+	};
+
+	// moves the per-draw decisions of gpuCulled passes to a compute shader.
+	// while recording, the scene hands over runs of sorted packets that share state; each run becomes a single
+	// vkCmdDrawIndexedIndirectCount, and its packets become draw records in a persistently mapped storage buffer.
+	// each frame, before the passes, the cull shader tests every record's ObjectData bounds against the frustum and
+	// a max depth pyramid of the previous frame's depth, and appends the survivors to their run's range of the command buffer.
+	// the CPU cost of a frame doesn't depend on the number of objects, and recorded command buffers stay valid as objects move.
+	// culled objects must have bounds in the ObjectBuffer, and their vertex shaders must take the object index from OBJECT_INDEX.
+	struct GpuCulling {
+		VulkanDevice* device;
+		Scene* scene;
+		GpuCullingInfo info;
+
+		// what the last recording of any image handed to the GPU
+		uint32_t recordedDraws = 0;
+		uint32_t recordedBatches = 0;
+
+		GpuCulling(Scene* scene, GpuCullingInfo info);
+		~GpuCulling();
+
+		// indirect count draws with a first instance, and multi draw indirect
+		static bool supported(VulkanDevice* device);
+
+		// writes image swapIdx's culling uniform. call once per frame, with the matrices the culled passes use.
+		void update(uint32_t swapIdx, const glm::mat4& view, const glm::mat4& proj);
+
+		// forgets image swapIdx's records, and points its descriptors at this recording's depth attachment.
+		// the pyramid is resized to match it. must come before anything else is recorded for the image.
+		void beginRecording(uint32_t swapIdx, VulkanTexture* depth, uint32_t width, uint32_t height);
+		// resets the counts and culls every record. must be outside a render pass, after the ObjectBuffer upload.
+		void recordCull(CommandRecorder& recorder, uint32_t swapIdx);
+		// records one indirect draw for the run of packets, which must share their bound state.
+		// returns false if the records or batches ran out, and the run has to be drawn on the CPU.
+		bool drawBatch(CommandRecorder& recorder, uint32_t swapIdx, const DrawPacket* packets, uint32_t count);
+		// reduces the depth attachment into the pyramid for the next frame's cull. it must be in SHADER_READ_ONLY_OPTIMAL.
+		void recordDepthPyramid(CommandRecorder& recorder, uint32_t swapIdx);
+
+	private:
+		// the draw count, padded to 16 bytes, comes before the records
+		static const VkDeviceSize RECORD_HEADER_SIZE = 16;
+
+		VkDeviceSize uniformOffset;
+		glm::mat4 prevViewProj = glm::mat4(1.0f);
+
+		// per swapchain image
+		std::vector<VkBuffer> recordBuffers;
+		std::vector<MemoryAllocation> recordAllocations;
+		std::vector<VkBuffer> commandBuffers;
+		std::vector<MemoryAllocation> commandAllocations;
+		std::vector<VkBuffer> countBuffers;
+		std::vector<MemoryAllocation> countAllocations;
+		std::vector<uint32_t> drawCounts;
+		std::vector<uint32_t> batchCounts;
+		std::vector<VulkanDescriptorSet*> cullSets;
+		std::vector<VulkanDescriptorSet*> depthSets;
+
+		VulkanDescriptorSetLayout* cullSetLayout;
+		VkPipelineLayout cullPipelineLayout;
+		VkPipeline cullPipeline;
+		VulkanDescriptorSetLayout* pyramidSetLayout;
+		VkPipelineLayout pyramidPipelineLayout;
+		VkPipeline pyramidPipeline;
+
+		// one pyramid for all images, as frames are culled and rendered in submission order
+		VulkanImage* pyramid = nullptr;
+		// every mip, for the cull shader
+		VulkanImageView* pyramidView = nullptr;
+		// one per mip, to write and read them one at a time
+		std::vector<VulkanImageView*> pyramidMipViews;
+		// mip k is reduced from mip k - 1 with mipSets[k]; mip 0 from the depth attachment, with depthSets
+		std::vector<VulkanDescriptorSet*> mipSets;
+		VulkanSampler* pyramidSampler;
+		uint32_t depthWidth = 0, depthHeight = 0;
+
+		VkPipeline createPipeline(const char* shader, VkPipelineLayout layout);
+		void createPyramid(uint32_t width, uint32_t height);
+		void destroyPyramid();
+		uint32_t pyramidWidth(uint32_t mip) const;
+		uint32_t pyramidHeight(uint32_t mip) const;
+	};
+}
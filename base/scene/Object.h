@@ -7,6 +7,7 @@
 
 #include "../VulkanMesh.h"
 #include "../VulkanMaterial.h"
+#include "DrawPacket.h"
 
 namespace vku {
 	struct Scene;
@@ -24,6 +25,10 @@ namespace vku {
 
 		virtual void render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial) = 0;
 		virtual glm::mat4 getAABBTransform() = 0;
+		// writes this object's entries in the scene's ObjectBuffer, once per frame
+		virtual void updateObjectData() {}
+		// appends this object's draws for the scene to sort and submit. returning false draws it through render() instead.
+		virtual bool collectDraws(std::vector<DrawPacket>& packets) { return false; }
 
 		virtual ~Object() {}
 	};
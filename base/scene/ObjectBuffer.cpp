@@ -0,0 +1,97 @@
+#include "ObjectBuffer.h"
+
+#include <stdexcept>
+#include <cstring>
+
+#include "../VulkanDevice.h"
+
+namespace vku {
+	ObjectBuffer::ObjectBuffer(VulkanDevice* device, uint32_t capacity, uint32_t frameCount) {
+		this->device = device;
+		this->capacity = capacity;
+
+		buffers.resize(frameCount);
+		allocations.resize(frameCount);
+		stagingBuffers.resize(frameCount);
+		stagingAllocations.resize(frameCount);
+		mapped.resize(frameCount);
+		for (uint32_t i = 0; i < frameCount; i++) {
+			device->createBuffer(size(),
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				stagingBuffers[i], stagingAllocations[i], MemoryCategory::Staging);
+			// mapped for the lifetime of the buffer
+			mapped[i] = static_cast<ObjectData*>(stagingAllocations[i].mapped);
+
+			device->createBuffer(size(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				buffers[i], allocations[i], MemoryCategory::Storage);
+		}
+	}
+
+	ObjectBuffer::~ObjectBuffer() {
+		for (uint32_t i = 0; i < buffers.size(); i++) {
+			device->destroyBuffer(stagingBuffers[i], stagingAllocations[i]);
+			device->destroyBuffer(buffers[i], allocations[i]);
+		}
+	}
+
+	uint32_t ObjectBuffer::allocate() {
+		uint32_t index;
+		if (!freeIndices.empty()) {
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else {
+			if (objects.size() >= capacity) {
+				throw std::runtime_error("Object buffer is full!");
+			}
+			index = static_cast<uint32_t>(objects.size());
+			objects.push_back({});
+		}
+
+		objects[index] = {};
+		return index;
+	}
+
+	void ObjectBuffer::free(uint32_t index) {
+		// frames in flight keep their own copy, so the entry can be reused right away
+		freeIndices.push_back(index);
+	}
+
+	void ObjectBuffer::update(uint32_t i) {
+		if (objects.empty()) {
+			return;
+		}
+
+		memcpy(mapped[i], objects.data(), sizeof(ObjectData) * objects.size());
+		for (ObjectData& object : objects) {
+			object.prevTransform = object.transform;
+		}
+	}
+
+	void ObjectBuffer::recordUpload(VkCommandBuffer cb, uint32_t i) {
+		if (objects.empty()) {
+			return;
+		}
+
+		VkBufferCopy region{};
+		region.size = sizeof(ObjectData) * objects.size();
+		vkCmdCopyBuffer(cb, stagingBuffers[i], buffers[i], 1, &region);
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffers[i];
+		barrier.offset = 0;
+		barrier.size = region.size;
+		vkCmdPipelineBarrier(cb,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+}
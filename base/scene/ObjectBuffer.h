@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+namespace vku {
+	struct VulkanDevice;
+
+	// one entry of the per-object storage buffer. matches ObjectData in shaders/scene/objects.glsl (std430).
+	struct ObjectData {
+		glm::mat4 transform = glm::mat4(1.0f);
+		// the transform as of the previous update, maintained by the ObjectBuffer
+		glm::mat4 prevTransform = glm::mat4(1.0f);
+		// object space bounding box
+		glm::vec3 boundsMin = glm::vec3(0.0f);
+		uint32_t materialIndex = 0;
+		glm::vec3 boundsMax = glm::vec3(0.0f);
+		uint32_t padding = 0;
+	};
+	static_assert(sizeof(ObjectData) == 160, "ObjectData must match its std430 layout");
+
+	// per-object data for every draw in a scene, so draws only push a 4 byte object index.
+	// objects write their entries on the CPU; update() copies them into a persistently mapped staging buffer,
+	// and recordUpload() copies that into the device local storage buffer the shaders read.
+	// there is one staging / storage buffer pair per swapchain image.
+	struct ObjectBuffer {
+		VulkanDevice* device;
+		uint32_t capacity;
+
+		std::vector<VkBuffer> buffers;
+		std::vector<MemoryAllocation> allocations;
+
+		ObjectBuffer(VulkanDevice* device, uint32_t capacity, uint32_t frameCount);
+		~ObjectBuffer();
+
+		// returns the index of an unused entry, reset to identity transforms
+		uint32_t allocate();
+		void free(uint32_t index);
+
+		ObjectData& operator[](uint32_t index) { return objects[index]; }
+
+		// copies every entry into frame i's staging buffer, then carries the transforms over into prevTransform
+		void update(uint32_t i);
+		// copies frame i's staging buffer into its storage buffer. must be outside a render pass.
+		// the size is fixed at record time, which is fine as long as objects are added before their draws are recorded.
+		void recordUpload(VkCommandBuffer cb, uint32_t i);
+
+		VkDeviceSize size() const { return sizeof(ObjectData) * capacity; }
+		uint32_t count() const { return static_cast<uint32_t>(objects.size() - freeIndices.size()); }
+
+	private:
+		std::vector<ObjectData> objects;
+		std::vector<uint32_t> freeIndices;
+
+		std::vector<VkBuffer> stagingBuffers;
+		std::vector<MemoryAllocation> stagingAllocations;
+		std::vector<ObjectData*> mapped;
+	};
+}
@@ -1,14 +1,20 @@
 #include "Scene.h"
 
 #include <stdexcept>
+#include <cstring>
+#include <algorithm>
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 
 #include "../VulkanDevice.h";
 #include "../VulkanSwapchain.h"
-#include "../VulkanUniform.h"
+#include "../UniformRing.h"
 #include "../VulkanDescriptorSet.h"
+#include "../descriptor/DescriptorWriter.h"
+#include "../descriptor/DescriptorLayoutCache.h"
+#include "ObjectBuffer.h"
+#include "../VulkanMaterial.h"
 
 #include "Object.h"
 
@@ -18,10 +24,11 @@ namespace vku {
 		this->device = device;
 		std::vector<DescriptorLayout> descriptorLayouts{};
 		for (uint32_t i = 0; i < info.uniformAllocSizes.size(); i++) {
-			descriptorLayouts.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS });
+			descriptorLayouts.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_ALL_GRAPHICS });
 		}
+		descriptorLayouts.insert(descriptorLayouts.begin() + std::min<size_t>(OBJECT_BUFFER_BINDING, descriptorLayouts.size()), { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS });
 
-		this->globalDescriptorSetLayout = new VulkanDescriptorSetLayout(device, descriptorLayouts);
+		this->globalDescriptorSetLayout = device->descriptorLayoutCache->acquireSetLayout(descriptorLayouts);
 
 		{
 			VkPushConstantRange range{};
@@ -29,30 +36,32 @@ namespace vku {
 			range.size = 128;
 			range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT;
 
-			VkPipelineLayoutCreateInfo pipelineLayoutCI{};
-			pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-			pipelineLayoutCI.setLayoutCount = 1;
-			VkDescriptorSetLayout layout = *globalDescriptorSetLayout;
-			pipelineLayoutCI.pSetLayouts = &layout;
-			pipelineLayoutCI.pushConstantRangeCount = 1;
-			pipelineLayoutCI.pPushConstantRanges = &range;
-
-			if (vkCreatePipelineLayout(*device, &pipelineLayoutCI, nullptr, &globalPipelineLayout) != VK_SUCCESS) {
-				throw std::runtime_error("Failed to create pipeline layout.");
-			}
+			globalPipelineLayout = device->descriptorLayoutCache->acquirePipelineLayout({ globalDescriptorSetLayout->handle }, { range });
 		}
 
 		uint32_t n = this->device->swapchain->swapChainLength;
 
-		this->globalUniforms.resize(n);
+		this->objectBuffer = new ObjectBuffer(device, info.maxObjects, n);
+
+		// every image's copy of a uniform is at the same offset of its own ring slice
+		this->globalUniformSizes = info.uniformAllocSizes;
+		for (size_t size : globalUniformSizes) {
+			globalUniformOffsets.push_back(device->uniformRing->reserve(size));
+		}
+
 		this->globalDescriptorSets.resize(n);
+		DescriptorWriter writer(device);
 		for (uint32_t i = 0; i < n; i++) {
 			globalDescriptorSets[i] = new VulkanDescriptorSet(globalDescriptorSetLayout);
-			globalUniforms[i].resize(info.uniformAllocSizes.size());
-			for (uint32_t k = 0; k < globalUniforms[i].size(); k++) {
-				globalUniforms[i][k] = new VulkanUniform(device, info.uniformAllocSizes[k]);
-				globalDescriptorSets[i]->write(k, globalUniforms[i][k]);
+			for (uint32_t k = 0; k < globalUniformSizes.size(); k++) {
+				writer.write(globalDescriptorSets[i], uniformBinding(k), device->uniformRing->buffer, globalUniformSizes[k], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 			}
+			writer.write(globalDescriptorSets[i], OBJECT_BUFFER_BINDING, objectBuffer->buffers[i], objectBuffer->size());
+		}
+		writer.flush();
+
+		if (info.gpuCulling && GpuCulling::supported(device)) {
+			this->gpuCulling = new GpuCulling(this, info.gpuCullingInfo);
 		}
 	}
 
@@ -60,30 +69,156 @@ namespace vku {
 		for (Object* obj : objects) {
 			delete obj;
 		}
-
-		vkDestroyPipelineLayout(*device, globalPipelineLayout, nullptr);
-		delete globalDescriptorSetLayout;
-		for (auto uniforms : globalUniforms) {
-			for (VulkanUniform *uniform : uniforms) {
-				delete uniform;
-			}
+		delete gpuCulling;
+		delete objectBuffer;
+		for (size_t k = 0; k < globalUniformOffsets.size(); k++) {
+			device->uniformRing->release(globalUniformOffsets[k], globalUniformSizes[k]);
 		}
+
+		device->descriptorLayoutCache->releasePipelineLayout(globalPipelineLayout);
+		device->descriptorLayoutCache->releaseSetLayout(globalDescriptorSetLayout);
 	}
 
 	void Scene::addObject(Object* object) {
 		objects.push_back(object);
 	}
 
-	void Scene::render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial, uint32_t layerMask) {
+	void Scene::render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial, uint32_t layerMask, bool gpuCulled) {
+		CommandRecorder recorder(cmdBuf);
+		render(recorder, swapIdx, noMaterial, layerMask, gpuCulled);
+	}
+
+	void Scene::render(CommandRecorder& recorder, uint32_t swapIdx, bool noMaterial, uint32_t layerMask, bool gpuCulled) {
+		CommandRecorderStats statsBefore = recorder.stats;
+
+		drawPackets.clear();
+		bool renderedDirectly = false;
 		for (Object* obj : objects) {
-			if ((obj->layer & layerMask) != 0) {
-				obj->render(cmdBuf, swapIdx, noMaterial);
+			if ((obj->layer & layerMask) != 0 && !obj->collectDraws(drawPackets)) {
+				obj->render(recorder.cmdbuf, swapIdx, noMaterial);
+				renderedDirectly = true;
+			}
+		}
+		// those objects record straight into the command buffer, so the recorder can't trust what it last saw
+		if (renderedDirectly) {
+			recorder.invalidate();
+		}
+
+		passIds.clear();
+		pipelineIds.clear();
+		materialIds.clear();
+		meshIds.clear();
+
+		size_t drawCount = 0;
+		for (DrawPacket& packet : drawPackets) {
+			uint32_t pass = 0, pipeline = 0, material = 0;
+			if (!noMaterial) {
+				// the pipeline may still be compiling, in which case the pass fallback is drawn instead
+				packet.materialInstance = packet.materialInstance->resolve();
+				if (packet.materialInstance == nullptr) {
+					continue;
+				}
+				VulkanMaterial* mat = packet.materialInstance->material;
+				pass = keyId(passIds, mat->pass);
+				pipeline = keyId(pipelineIds, mat->pipeline);
+				material = keyId(materialIds, packet.materialInstance);
+			}
+			// meshes in the same geometry arena share their buffers, and with them this id
+			uint32_t mesh = keyId(meshIds, packet.vertexBuffer);
+
+			const ObjectData& object = (*objectBuffer)[packet.objectIndex];
+			glm::vec3 center = glm::vec3(object.transform * glm::vec4((object.boundsMin + object.boundsMax) * 0.5f, 1.0f));
+			uint32_t depth = DrawKey::depth(glm::distance(center, sortOrigin));
+
+			packet.key = DrawKey::make(pass, pipeline, material, mesh, depth);
+			drawPackets[drawCount++] = packet;
+		}
+		drawPackets.resize(drawCount);
+
+		radixSort(drawPackets, sortScratch);
+
+		// sorted packets share state with their neighbours, so they come in runs that bind the same things
+		bool culled = gpuCulled && gpuCulling != nullptr;
+		for (size_t first = 0; first < drawPackets.size();) {
+			const DrawPacket& packet = drawPackets[first];
+			size_t last = first + 1;
+			while (last < drawPackets.size()
+				&& (noMaterial || drawPackets[last].materialInstance == packet.materialInstance)
+				&& drawPackets[last].vertexBuffer == packet.vertexBuffer
+				&& drawPackets[last].indexBuffer == packet.indexBuffer) {
+				last++;
+			}
+
+			if (!noMaterial) {
+				packet.materialInstance->material->bind(recorder);
+				packet.materialInstance->bind(recorder, swapIdx);
 			}
+			recorder.bindVertexBuffer(packet.vertexBuffer);
+			recorder.bindIndexBuffer(packet.indexBuffer);
+
+			if (!culled || !gpuCulling->drawBatch(recorder, swapIdx, &drawPackets[first], static_cast<uint32_t>(last - first))) {
+				for (size_t k = first; k < last; k++) {
+					pushObjectIndex(recorder, drawPackets[k].objectIndex);
+					recorder.drawIndexed(drawPackets[k].indexCount, 1, drawPackets[k].firstIndex, drawPackets[k].vertexOffset, 0);
+				}
+			}
+			first = last;
+		}
+
+		renderStats = recorder.stats - statsBefore;
+	}
+
+	uint32_t Scene::keyId(std::unordered_map<const void*, uint32_t>& ids, const void* handle) {
+		auto it = ids.find(handle);
+		if (it != ids.end()) {
+			return it->second;
+		}
+		uint32_t id = static_cast<uint32_t>(ids.size());
+		ids[handle] = id;
+		return id;
+	}
+
+	std::vector<uint32_t> Scene::dynamicOffsets(uint32_t swapIdx) {
+		// dynamic offsets go in binding order, which is also uniform order
+		std::vector<uint32_t> offsets;
+		for (VkDeviceSize offset : globalUniformOffsets) {
+			offsets.push_back(device->uniformRing->get(swapIdx, offset).offset);
 		}
+		return offsets;
+	}
+
+	void Scene::bind(VkCommandBuffer cmdBuf, uint32_t swapIdx) {
+		std::vector<uint32_t> offsets = dynamicOffsets(swapIdx);
+		vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, globalPipelineLayout, 0, 1, &globalDescriptorSets[swapIdx]->handle, static_cast<uint32_t>(offsets.size()), offsets.data());
+	}
+
+	void Scene::bind(CommandRecorder& recorder, uint32_t swapIdx) {
+		std::vector<uint32_t> offsets = dynamicOffsets(swapIdx);
+		recorder.bindDescriptorSets(VK_PIPELINE_BIND_POINT_GRAPHICS, globalPipelineLayout, 0, 1, &globalDescriptorSets[swapIdx]->handle, static_cast<uint32_t>(offsets.size()), offsets.data());
 	}
 
 	void Scene::updateUniforms(uint32_t swapIdx, uint32_t uniformIdx, void* data) {
-		globalUniforms[swapIdx][uniformIdx]->write(data);
+		memcpy(device->uniformRing->get(swapIdx, globalUniformOffsets[uniformIdx]).data, data, globalUniformSizes[uniformIdx]);
+	}
+
+	void Scene::updateObjects(uint32_t swapIdx) {
+		for (Object* obj : objects) {
+			obj->updateObjectData();
+		}
+		objectBuffer->update(swapIdx);
+	}
+
+	void Scene::pushObjectIndex(VkCommandBuffer cmdBuf, uint32_t objectIndex) {
+		// every pipeline layout shares the scene's push constant range, so this layout is compatible with all of them
+		vkCmdPushConstants(cmdBuf, globalPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &objectIndex);
+	}
+
+	void Scene::pushObjectIndex(CommandRecorder& recorder, uint32_t objectIndex) {
+		recorder.pushConstants(globalPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &objectIndex);
+	}
+
+	uint32_t Scene::uniformBinding(uint32_t uniformIdx) {
+		return uniformIdx < OBJECT_BUFFER_BINDING ? uniformIdx : uniformIdx + 1;
 	}
 
 	glm::mat4 Scene::getAABBTransform() {
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 
 #include "../VulkanDevice.h"
+#include "DrawPacket.h"
+#include "GpuCulling.h"
+#include "../CommandRecorder.h"
 
 namespace vku {
 	struct Object;
@@ -13,7 +17,7 @@ namespace vku {
 	struct DescriptorLayout;
 	struct VulkanDescriptorSetLayout;
 	struct VulkanDescriptorSet;
-	struct VulkanUniform;
+	struct ObjectBuffer;
 
 	struct SceneGlobalUniform
 	{
@@ -28,25 +32,68 @@ namespace vku {
 	struct SceneInfo {
 		// list of sizes of uniform buffers to install at binding. Default SceneGlobalUniform
 		std::vector<size_t> uniformAllocSizes{ sizeof(SceneGlobalUniform) };
+		// entries in the per-object storage buffer
+		uint32_t maxObjects = 4096;
+		// cull the draws of gpuCulled passes in a compute shader, if the device supports it
+		bool gpuCulling = false;
+		GpuCullingInfo gpuCullingInfo{};
 	};
 
 	struct Scene {
+		// set 0 is the first uniform, then the object buffer, then the rest of the uniforms
+		static const uint32_t OBJECT_BUFFER_BINDING = 1;
+
 		VulkanDevice* device;
 		VulkanDescriptorSetLayout* globalDescriptorSetLayout;
 		VkPipelineLayout globalPipelineLayout;
 		std::vector<VulkanDescriptorSet*> globalDescriptorSets;
-		std::vector<std::vector<VulkanUniform*>> globalUniforms;
+		// the scene uniforms live in the device's UniformRing; these are their reserved ranges
+		std::vector<VkDeviceSize> globalUniformOffsets;
+		std::vector<size_t> globalUniformSizes;
+		ObjectBuffer* objectBuffer;
+		// null unless SceneInfo::gpuCulling was set and the device supports it
+		GpuCulling* gpuCulling = nullptr;
 
 		std::vector<Object*> objects{};
 
+		// draws are sorted front to back from here. set it to the camera position.
+		glm::vec3 sortOrigin = glm::vec3(0.0f);
+		// what the last render recorded, and what it found already bound
+		CommandRecorderStats renderStats;
+
 		Scene(VulkanDevice* device, SceneInfo info);
 		~Scene();
 
 		void addObject(Object* object);
-		void render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial, uint32_t layerMask);
+		// objects that don't hand out draw packets are rendered first, in the order they were added.
+		// the packets of all other objects are then sorted by key, and submitted through the recorder, which binds only what changed.
+		// with gpuCulled, each run of packets sharing their state is a single indirect draw, filled in by gpuCulling.
+		void render(CommandRecorder& recorder, uint32_t swapIdx, bool noMaterial, uint32_t layerMask, bool gpuCulled = false);
+		void render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial, uint32_t layerMask, bool gpuCulled = false);
+
+		// binds set 0 with swapchain image swapIdx's uniforms
+		void bind(VkCommandBuffer cmdBuf, uint32_t swapIdx);
+		void bind(CommandRecorder& recorder, uint32_t swapIdx);
 
 		void updateUniforms(uint32_t swapIdx, uint32_t uniformIdx, void* data);
+		// lets every object write its entries, then stages the object buffer for this frame. call once per frame.
+		void updateObjects(uint32_t swapIdx);
+		// the only push constant per draw: which object buffer entry to use
+		void pushObjectIndex(VkCommandBuffer cmdBuf, uint32_t objectIndex);
+		void pushObjectIndex(CommandRecorder& recorder, uint32_t objectIndex);
+
+		static uint32_t uniformBinding(uint32_t uniformIdx);
 
 		glm::mat4 getAABBTransform();
+
+	private:
+		// reused between renders
+		std::vector<DrawPacket> drawPackets;
+		std::vector<DrawPacket> sortScratch;
+		// dense ids for the sort key fields, handed out in the order things are first seen
+		std::unordered_map<const void*, uint32_t> passIds, pipelineIds, materialIds, meshIds;
+
+		static uint32_t keyId(std::unordered_map<const void*, uint32_t>& ids, const void* handle);
+		std::vector<uint32_t> dynamicOffsets(uint32_t swapIdx);
 	};
 }
\ No newline at end of file
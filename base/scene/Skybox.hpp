@@ -8,6 +8,7 @@
 #include "Scene.h"
 #include "../VulkanMaterial.h"
 #include "../VulkanTexture.h"
+#include "../SamplerCache.h"
 #include "../rendergraph/RenderGraph.h"
 
 namespace vku {
@@ -35,7 +36,7 @@ namespace vku {
 			skybox->image->writeImageViewInfo(&viewInfo);
 			viewInfo.imageViewType = VK_IMAGE_VIEW_TYPE_CUBE;
 			skybox->view = new VulkanImageView(scene->device, viewInfo);
-			skybox->sampler = new VulkanSampler(scene->device, {});
+			skybox->sampler = scene->device->samplerCache->get({});
 
 			// make material
 			// skyboxes don't care about depth testing / writing
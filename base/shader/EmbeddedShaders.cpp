@@ -0,0 +1,22 @@
+#include "EmbeddedShaders.h"
+
+#include <algorithm>
+
+namespace vku {
+#ifndef VKMERC_EMBEDDED_SHADERS
+	// otherwise defined by the generated translation unit
+	const EmbeddedShader* const embeddedShaders = nullptr;
+	const size_t embeddedShaderCount = 0;
+#endif
+
+	const EmbeddedShader* findEmbeddedShader(size_t hash) {
+		const EmbeddedShader* end = embeddedShaders + embeddedShaderCount;
+		const EmbeddedShader* found = std::lower_bound(embeddedShaders, end, hash, [](const EmbeddedShader& shader, size_t hash) {
+			return shader.hash < hash;
+		});
+		if (found == end || found->hash != hash) {
+			return nullptr;
+		}
+		return found;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vku {
+	// a SPIR-V blob compiled into the binary by `vkmerc-shaderbake --embed` (EMBED_SHADERS in CMake)
+	struct EmbeddedShader {
+		// ShaderVariant::getHashcode() of the variant
+		size_t hash;
+		const uint32_t* spirv;
+		size_t wordCount;
+	};
+
+	// the generated table, sorted by hash. empty unless built with EMBED_SHADERS.
+	extern const EmbeddedShader* const embeddedShaders;
+	extern const size_t embeddedShaderCount;
+
+	// nullptr if the variant wasn't embedded
+	const EmbeddedShader* findEmbeddedShader(size_t hash);
+}
@@ -12,17 +12,23 @@
 #endif
 
 #include <unordered_set>
+#include <algorithm>
 #include <filesystem>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 
-#include <shaderc/shaderc.hpp>
-
 #include "../VulkanDevice.h"
 #include "ShaderVariant.h"
 #include "ShaderModule.h"
-#include "ShadercIncluder.h"
+#include "ShaderManifest.h"
+#include "ShaderTable.h"
+#include "ShaderCompilerPool.h"
+#include "EmbeddedShaders.h"
+#include "../util/DeletionQueue.h"
+#ifndef VKMERC_NO_SHADERC
+#include "ShaderCompiler.h"
+#endif
 
 std::vector<uint32_t> readFileIntVec(const std::string& filename) {
 	std::ifstream file(filename, std::ios::ate | std::ios::binary);
@@ -42,47 +48,19 @@ std::vector<uint32_t> readFileIntVec(const std::string& filename) {
 	return buffer;
 }
 
-std::vector<char> readFileCharVec(const std::string& filename) {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-	if (!file.is_open()) {
-		throw std::runtime_error("Failed to open file!");
-	}
-
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<char> buffer(fileSize);
-
-	file.seekg(0);
-	file.read((char*)buffer.data(), fileSize);
-
-	file.close();
-
-	return buffer;
-}
-
-shaderc_shader_kind getShaderKind(const std::string& path) {
-	int idx = path.rfind('.');
+VkShaderStageFlagBits getShaderStage(const std::string& path) {
+	size_t idx = path.rfind('.');
 	if (idx != std::string::npos) {
 		std::string ext = path.substr(idx + 1);
-		if (ext == "vert") return shaderc_glsl_vertex_shader;
-		else if (ext == "tesc") return shaderc_glsl_tess_control_shader;
-		else if (ext == "tese") return shaderc_glsl_tess_evaluation_shader;
-		else if (ext == "geom") return shaderc_glsl_geometry_shader;
-		else if (ext == "frag") return shaderc_glsl_fragment_shader;
-		else if (ext == "comp") return shaderc_glsl_compute_shader;
+		if (ext == "vert") return VK_SHADER_STAGE_VERTEX_BIT;
+		else if (ext == "tesc") return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		else if (ext == "tese") return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		else if (ext == "geom") return VK_SHADER_STAGE_GEOMETRY_BIT;
+		else if (ext == "frag") return VK_SHADER_STAGE_FRAGMENT_BIT;
+		else if (ext == "comp") return VK_SHADER_STAGE_COMPUTE_BIT;
 	}
 
-	throw std::runtime_error("Error compiling shader, invalid filename: '" + path + "'");
-}
-
-VkShaderStageFlagBits shadercKindToVkFlag(const shaderc_shader_kind kind) {
-	if (kind == shaderc_glsl_vertex_shader) return VK_SHADER_STAGE_VERTEX_BIT;
-	else if (kind == shaderc_glsl_tess_control_shader) return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
-	else if (kind == shaderc_glsl_tess_evaluation_shader) return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
-	else if (kind == shaderc_glsl_geometry_shader) return VK_SHADER_STAGE_GEOMETRY_BIT;
-	else if (kind == shaderc_glsl_fragment_shader) return VK_SHADER_STAGE_FRAGMENT_BIT;
-	else if (kind == shaderc_glsl_compute_shader) return VK_SHADER_STAGE_COMPUTE_BIT;
-	return {};
+	throw std::runtime_error("Invalid shader filename: '" + path + "'");
 }
 
 time_t getModTime(const std::string& filePath) {
@@ -158,51 +136,55 @@ bool isShaderModified(const std::string& shaderPath, const std::string& spvPath,
 	return areShaderIncludesModified(spvModTime, shaderPath, mostRecentChange);
 }
 
-std::vector<uint32_t> recompileShader(const std::string& sourcePath, const std::map<std::string, std::string> macros, const std::string& spvPath) {
-	std::cout << "Compiling '" << sourcePath << "'" << std::endl;
-
-	std::vector<char> glslSourceVec = readFileCharVec(sourcePath);
-	std::string glslSource(glslSourceVec.begin(), glslSourceVec.end());
-
-	shaderc_shader_kind shaderType = getShaderKind(sourcePath);
-
-	shaderc::Compiler compiler{};
-	shaderc::CompileOptions options{};
+std::vector<uint32_t> recompileShader(vku::ShaderCompilerPool* compilerPool, const std::string& sourcePath, const std::map<std::string, std::string> macros, const std::string& spvPath) {
+	if (compilerPool != nullptr) {
+		std::cout << "Compiling '" << sourcePath << "' in a worker process" << std::endl;
+		try {
+			return compilerPool->compile(sourcePath, macros, spvPath);
+		}
+		catch (const std::runtime_error& e) {
+			std::cout << e.what() << std::endl;
+			throw;
+		}
+	}
 
-	// hook #include api
-	ShadercIncluder *includer = new ShadercIncluder();
-	shaderc::CompileOptions::IncluderInterface *includerPtr = includer;
-	options.SetIncluder(std::unique_ptr<shaderc::CompileOptions::IncluderInterface>(includerPtr));
+#ifdef VKMERC_NO_SHADERC
+	throw std::runtime_error("'" + spvPath + "' was not baked, and shader compilation is disabled in this build.");
+#else
+	std::cout << "Compiling '" << sourcePath << "'" << std::endl;
 
-	for (auto macro : macros) {
-		options.AddMacroDefinition(macro.first, macro.second);
+	std::string errorMessage;
+	std::vector<uint32_t> spirvData;
+	try {
+		spirvData = vku::compileShader(sourcePath, macros, &errorMessage);
 	}
-	options.SetWarningsAsErrors();
-	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(glslSource, shaderType, sourcePath.c_str(), options);
-	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
-		std::cout << result.GetErrorMessage() << std::endl;
-		throw std::runtime_error("Error compiling '" + sourcePath + "'");
+	catch (const std::runtime_error& e) {
+		std::cout << errorMessage << std::endl;
+		throw;
 	}
 
-	std::vector<uint32_t> spirvData(result.cbegin(), result.cend());
-
-	std::ofstream outStream(spvPath, std::ios::binary);
-	outStream.write((char*)spirvData.data(), spirvData.size() * sizeof(uint32_t));
-	outStream.close();
+	vku::writeSpirv(spvPath, spirvData);
 
 	return spirvData;
+#endif
 }
 
 namespace vku {
 
 	ShaderCache::ShaderCache(VulkanDevice* device) {
 		this->device = device;
+		this->runtimeShaderCache.store(new ShaderTable(256));
 	}
 
 	void ShaderCache::setSourceDirectory(const std::string& newShaderDirectory) {
 		this->shaderDirectory = newShaderDirectory;
 	}
 
+	void ShaderCache::useCompilerWorkers(const std::string& workerPath, uint32_t workerCount) {
+		delete compilerPool;
+		compilerPool = new ShaderCompilerPool(workerPath, workerCount);
+	}
+
 	ShaderModule* ShaderCache::get(const std::string& name) {
 		ShaderVariant variant{};
 		variant.name = std::string(name);
@@ -214,51 +196,144 @@ namespace vku {
 		size_t hash = variant.getHashcode();
 
 		// If it's in the cache, use it
-		if (runtimeShaderCache.find(hash) != runtimeShaderCache.end()) {
-			return runtimeShaderCache[hash];
+		ShaderModule* cached = runtimeShaderCache.load(std::memory_order_acquire)->find(hash);
+		if (cached != nullptr) {
+			return cached;
 		}
 
-		// convert hashcode to hex
-		std::stringstream stream;
-		stream << std::hex << variant.getHashcode();
-		std::string hexHash(stream.str());
+		return load(variant, hash);
+	}
+
+	ShaderModule* ShaderCache::acquireForBuild(const ShaderVariant& variant, ShaderCacheHotReloadCallback callback) {
+		size_t hash = variant.getHashcode();
+		while (true) {
+			ShaderModule* shaderModule = get(variant);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			// hotReloadCheck may have published a new module since the lookup
+			if (runtimeShaderCache.load(std::memory_order_relaxed)->find(hash) != shaderModule) {
+				continue;
+			}
+			std::vector<ShaderCacheHotReloadCallback>& callbacks = shaderModule->hotReloadCallbacks;
+			// materials register again on every rebuild
+			if (std::find(callbacks.begin(), callbacks.end(), callback) == callbacks.end()) {
+				callbacks.push_back(callback);
+			}
+			shaderModule->buildsInProgress++;
+			return shaderModule;
+		}
+	}
+
+	void ShaderCache::releaseFromBuild(ShaderModule* module) {
+		std::lock_guard<std::mutex> lock(mutex);
+		module->buildsInProgress--;
+	}
+
+	ShaderModule* ShaderCache::load(const ShaderVariant& variant, size_t hash) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (true) {
+				ShaderModule* cached = runtimeShaderCache.load(std::memory_order_relaxed)->find(hash);
+				if (cached != nullptr) {
+					return cached;
+				}
+				// another thread is already loading it
+				if (loading.insert(hash).second) {
+					break;
+				}
+				loadFinished.wait(lock);
+			}
+		}
 
 		// get file paths
 		std::string shaderPath = shaderDirectory + variant.name;
-		std::string spvPath = shaderPath + "." + hexHash + ".spv";
+		std::string spvPath = variant.getSpirvPath(shaderDirectory);
 
-		std::vector<uint32_t> spirv;
+		ShaderModule* shader;
+		try {
+			std::vector<uint32_t> spirv;
 
-		time_t dummy;
-		if (isShaderModified(shaderPath, spvPath, &dummy)) {
-			spirv = recompileShader(shaderPath, variant.macros, spvPath);
+			// SPIR-V compiled into the binary needs no file system access at all
+			const EmbeddedShader* embedded = useEmbeddedShaders ? findEmbeddedShader(hash) : nullptr;
+			if (embedded != nullptr) {
+				spirv.assign(embedded->spirv, embedded->spirv + embedded->wordCount);
+			}
+#ifdef VKMERC_NO_SHADERC
+			// sources may not even ship, so without workers only ever load what vkmerc-shaderbake produced
+			else if (compilerPool == nullptr) {
+				try {
+					spirv = readFileIntVec(spvPath);
+				}
+				catch (const std::runtime_error& e) {
+					throw std::runtime_error("Shader variant '" + spvPath + "' was not baked, and shader compilation is disabled in this build.");
+				}
+			}
+#endif
+			else {
+				time_t dummy;
+				if (isShaderModified(shaderPath, spvPath, &dummy)) {
+					spirv = recompileShader(compilerPool, shaderPath, variant.macros, spvPath);
+				}
+				else {
+					spirv = readFileIntVec(spvPath);
+				}
+			}
+
+			VkShaderStageFlagBits shaderStage = getShaderStage(shaderPath);
+			shader = new ShaderModule(device, spirv, shaderStage);
+			shader->info = variant;
 		}
-		else {
-			spirv = readFileIntVec(spvPath);
+		catch (...) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				loading.erase(hash);
+			}
+			loadFinished.notify_all();
+			throw;
 		}
 
-		shaderc_shader_kind kind = getShaderKind(shaderPath);
-		VkShaderStageFlagBits shaderStage = shadercKindToVkFlag(kind);
-		ShaderModule* shader = new ShaderModule(device, spirv, shaderStage);
-		shader->info = variant;
-		this->runtimeShaderCache[hash] = shader;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			publish(hash, shader);
+			loading.erase(hash);
+		}
+		loadFinished.notify_all();
 		return shader;
 	}
 
-	void ShaderCache::hotReloadCheck(Semaphore* initiateReload, Semaphore* allowContinue, std::atomic<bool> *requestReloadFlag) {
-		std::unordered_set<ShaderCacheHotReloadCallback> callbacks{};
-		std::vector<ShaderModule*> condemnedToDeletion{};
-		for (auto& cached : runtimeShaderCache) {
-			size_t hash = cached.first;
+	ShaderModule* ShaderCache::publish(size_t hash, ShaderModule* module) {
+		ShaderTable* table = runtimeShaderCache.load(std::memory_order_relaxed);
+		if (table->find(hash) == nullptr && table->full()) {
+			// readers keep using the old table until they see the new one, which already has everything
+			ShaderTable* grown = new ShaderTable(table->capacity * 2);
+			for (auto& [cachedHash, cached] : table->entries()) {
+				grown->store(cachedHash, cached);
+			}
+			grown->store(hash, module);
+			runtimeShaderCache.store(grown, std::memory_order_release);
+			retiredTables.push_back(table);
+			return nullptr;
+		}
+		return table->store(hash, module);
+	}
+
+	void ShaderCache::hotReloadCheck() {
+		// work on a snapshot, so nothing waits on the lock while shaders recompile
+		std::vector<std::pair<size_t, ShaderModule*>> cachedModules;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cachedModules = runtimeShaderCache.load(std::memory_order_relaxed)->entries();
+		}
 
-			// convert hashcode to hex
-			std::stringstream stream;
-			stream << std::hex << hash;
-			std::string hexHash(stream.str());
+		for (auto& [hash, cached] : cachedModules) {
+			// embedded modules have no .spv on disk to compare against, so they're left alone
+			if (useEmbeddedShaders && findEmbeddedShader(hash) != nullptr) {
+				continue;
+			}
 
 			// get file paths
-			std::string shaderPath = shaderDirectory + cached.second->info.name;
-			std::string spvPath = shaderPath + "." + hexHash + ".spv";
+			std::string shaderPath = shaderDirectory + cached->info.name;
+			std::string spvPath = cached->info.getSpirvPath(shaderDirectory);
 
 			time_t mostRecentChange;
 			bool shaderModified;
@@ -268,75 +343,166 @@ namespace vku {
 			catch (const std::runtime_error& e) {
 				continue;
 			}
-			if (shaderModified) {
-				time_t lastFailure = 0;
-				auto failRecord = lastFailedHotCompilation.find(hash);
-				if (failRecord != lastFailedHotCompilation.end()) {
-					lastFailure = failRecord->second;
-				}
+			if (!shaderModified) {
+				continue;
+			}
 
-				if (mostRecentChange > lastFailure) {
-					std::vector<uint32_t> spirv;
-					try {
-						spirv = recompileShader(shaderPath, cached.second->info.macros, spvPath);
-					}
-					catch (const std::runtime_error& e) {
-						lastFailedHotCompilation[hash] = mostRecentChange;
-						continue;
-					}
-					shaderc_shader_kind kind = getShaderKind(shaderPath);
-					VkShaderStageFlagBits shaderStage = shadercKindToVkFlag(kind);
-
-					// delete later when it's fully replaced in dependencies
-					condemnedToDeletion.push_back(cached.second);
-
-					ShaderModule* shader = new ShaderModule(device, spirv, shaderStage);
-					shader->info = cached.second->info;
-
-					for (auto& callback : cached.second->hotReloadCallbacks) {
-						callbacks.insert(callback);
-					}
-
-					this->runtimeShaderCache[hash] = shader;
-				}
+			time_t lastFailure = 0;
+			auto failRecord = lastFailedHotCompilation.find(hash);
+			if (failRecord != lastFailedHotCompilation.end()) {
+				lastFailure = failRecord->second;
+			}
+			if (mostRecentChange <= lastFailure) {
+				continue;
 			}
-		}
 
-		if (callbacks.size() > 0) {
-			{
-				ZoneScopedNC("Requesting Reload", 0xFF0000);
-				requestReloadFlag->store(true);
-				initiateReload->acquire();
-				vkQueueWaitIdle(device->graphicsQueue);
-				vkQueueWaitIdle(device->presentQueue);
+			std::vector<uint32_t> spirv;
+			try {
+				spirv = recompileShader(compilerPool, shaderPath, cached->info.macros, spvPath);
+			}
+			catch (const std::runtime_error& e) {
+				lastFailedHotCompilation[hash] = mostRecentChange;
+				continue;
 			}
+			VkShaderStageFlagBits shaderStage = getShaderStage(shaderPath);
+
+			ShaderModule* shader = new ShaderModule(device, spirv, shaderStage);
+			shader->info = cached->info;
 
 			{
-				ZoneScopedNC("Reload Callbacks", 0x00FF00);
-				for (ShaderCacheHotReloadCallback callback : callbacks) {
-					callback.fun();
+				std::lock_guard<std::mutex> lock(mutex);
+				publish(hash, shader);
+			}
+			// the old module stays alive until its dependents are rebuilt on the render thread
+			{
+				std::lock_guard<std::mutex> lock(reloadMutex);
+				replacedModules.push_back(cached);
+			}
+		}
+	}
+
+	void ShaderCache::applyReloads() {
+		std::vector<ShaderModule*> replaced;
+		{
+			std::lock_guard<std::mutex> lock(reloadMutex);
+			replaced.swap(replacedModules);
+		}
+
+		std::unordered_set<ShaderCacheHotReloadCallback> callbacks{};
+		std::vector<ShaderModule*> unused;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (replaced.empty() && retiringModules.empty()) {
+				return;
+			}
+			for (ShaderModule* shaderModule : replaced) {
+				for (auto& callback : shaderModule->hotReloadCallbacks) {
+					callbacks.insert(callback);
 				}
-				allowContinue->release();
 			}
+
+			// a build that got a module before it was replaced may still be creating its pipeline from it
+			retiringModules.insert(retiringModules.end(), replaced.begin(), replaced.end());
+			auto inUse = std::partition(retiringModules.begin(), retiringModules.end(), [](ShaderModule* shaderModule) {
+				return shaderModule->buildsInProgress > 0;
+			});
+			unused.assign(inUse, retiringModules.end());
+			retiringModules.erase(inUse, retiringModules.end());
 		}
 
-		for (auto* shaderModule : condemnedToDeletion) {
-			delete shaderModule;
+		if (!callbacks.empty()) {
+			ZoneScopedNC("Reload Callbacks", 0x00FF00);
+			for (const ShaderCacheHotReloadCallback& callback : callbacks) {
+				callback.fun();
+			}
+		}
+
+		// pipelines don't reference their modules after creation, so only frames that haven't created theirs yet matter
+		for (ShaderModule* shaderModule : unused) {
+			device->deletionQueue->push([shaderModule]() {
+				delete shaderModule;
+			});
+		}
+	}
+
+	void ShaderCache::unregisterHotReloadCallbacks(size_t handle) {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::lock_guard<std::mutex> reloadLock(reloadMutex);
+
+		const auto& unregister = [handle](ShaderModule* shaderModule) {
+			std::vector<ShaderCacheHotReloadCallback>& callbacks = shaderModule->hotReloadCallbacks;
+			callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(), [handle](const ShaderCacheHotReloadCallback& callback) {
+				return callback.handle == handle;
+			}), callbacks.end());
+		};
+		for (auto& [hash, cached] : runtimeShaderCache.load(std::memory_order_relaxed)->entries()) {
+			unregister(cached);
+		}
+		for (ShaderModule* shaderModule : replacedModules) {
+			unregister(shaderModule);
+		}
+		for (ShaderModule* shaderModule : retiringModules) {
+			unregister(shaderModule);
+		}
+	}
+
+	void ShaderCache::writeUsageLog() {
+		if (usageLogPath.empty()) {
+			return;
+		}
+
+		// merge with earlier runs, so one log can cover several programs / sessions
+		std::map<size_t, ShaderVariant> used;
+		try {
+			for (const ShaderVariant& variant : readShaderManifest(usageLogPath)) {
+				used[variant.getHashcode()] = variant;
+			}
+		}
+		catch (const std::runtime_error& e) {
+			// no previous log
+		}
+		for (auto& [hash, cached] : runtimeShaderCache.load()->entries()) {
+			used[hash] = cached->info;
+		}
+
+		std::vector<ShaderVariant> variants;
+		for (auto& [hash, variant] : used) {
+			variants.push_back(variant);
+		}
+		try {
+			writeShaderManifest(usageLogPath, variants);
+		}
+		catch (const std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
 		}
 	}
 
 	ShaderCache::~ShaderCache() {
-		for (auto& cached : runtimeShaderCache) {
-			delete cached.second;
+		writeUsageLog();
+		delete compilerPool;
+
+		ShaderTable* table = runtimeShaderCache.load();
+		for (auto& [hash, cached] : table->entries()) {
+			delete cached;
+		}
+		delete table;
+		for (ShaderTable* retired : retiredTables) {
+			delete retired;
+		}
+		for (ShaderModule* shaderModule : replacedModules) {
+			delete shaderModule;
+		}
+		for (ShaderModule* shaderModule : retiringModules) {
+			delete shaderModule;
 		}
 	}
 	
-	void hotReloadCheckingThread(ShaderCache* shaderCache, Semaphore* initiateReload, Semaphore* allowContinue, std::atomic<bool>* requestReloadFlag, std::atomic<bool>* reloadThreadKill) {
+	void hotReloadCheckingThread(ShaderCache* shaderCache, std::atomic<bool>* reloadThreadKill) {
 		tracy::SetThreadName("Shader Hot Reloader");
 		while (true) {
 			{
 				ZoneScopedN("Shader Cached Reload Check");
-				shaderCache->hotReloadCheck(initiateReload, allowContinue, requestReloadFlag);
+				shaderCache->hotReloadCheck();
 			}
 			std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 			if (reloadThreadKill->load()) {
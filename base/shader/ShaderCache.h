@@ -4,15 +4,19 @@
 #include <vector>
 #include <map>
 #include <functional>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <unordered_set>
 
 #include <vulkan/vulkan.h>
 
-#include "../util/Semaphore.h"
-
 namespace vku {
 	struct VulkanDevice;
 	struct ShaderVariant;
 	struct ShaderModule;
+	struct ShaderTable;
+	struct ShaderCompilerPool;
 
 	struct ShaderCacheHotReloadCallback {
 		std::function<void()> fun;
@@ -26,25 +30,75 @@ namespace vku {
 	struct ShaderCache {
 		VulkanDevice* device;
 
-		std::map<size_t, ShaderModule*> runtimeShaderCache;
+		// the current table, read without locking. it is replaced by a larger copy as it fills up.
+		std::atomic<ShaderTable*> runtimeShaderCache;
 		std::map<size_t, time_t> lastFailedHotCompilation;
 
 		std::string shaderDirectory = "res/shaders/";
 
+		// every variant used is appended to this manifest on exit, for vkmerc-shaderbake to precompile. empty disables it.
+		std::string usageLogPath = "shader_usage.json";
+
+		// look up variants in the SPIR-V embedded at build time (EMBED_SHADERS) before touching the disk
+		bool useEmbeddedShaders = true;
+
+		// set by useCompilerWorkers. null compiles in-process.
+		ShaderCompilerPool* compilerPool = nullptr;
+
+		// serializes writers to the cache and guards module callbacks. lookups never take it.
+		std::mutex mutex;
+
 		ShaderCache(VulkanDevice *device);
 
 		void setSourceDirectory(const std::string &newShaderDirectory);
 
+		// compile in vkmerc-shaderbake worker processes rather than in-process with shaderc.
+		// this also makes compilation available to NO_SHADERC builds.
+		void useCompilerWorkers(const std::string& workerPath, uint32_t workerCount);
+
+		// safe from any thread. a cached module is returned without blocking; otherwise the variant is loaded,
+		// with concurrent requests for the same variant waiting on a single load.
 		ShaderModule* get(const std::string& name);
 		ShaderModule* get(const ShaderVariant& variant);
 		ShaderModule* get(size_t hash);
 
-		void hotReloadCheck(Semaphore* initiateReload, Semaphore* allowContinue, std::atomic<bool> *requestReloadFlag);
+		// for pipeline builds: the variant's current module, with the callback registered on it. a module that was replaced
+		// between the lookup and the registration is skipped, so the callback can't miss a reload. the module stays alive
+		// until the build gives it back with releaseFromBuild, even if it is replaced in the meantime.
+		ShaderModule* acquireForBuild(const ShaderVariant& variant, ShaderCacheHotReloadCallback callback);
+		void releaseFromBuild(ShaderModule* module);
+
+		// recompiles modified shaders and swaps them into the cache. runs on the hot reload thread.
+		void hotReloadCheck();
+		// rebuilds the pipelines of materials whose shaders were reloaded, and retires the old modules.
+		// only call this from the render thread, between frames.
+		void applyReloads();
+		// forget every callback registered under this handle, including on modules waiting to be retired
+		void unregisterHotReloadCallbacks(size_t handle);
+
+		void writeUsageLog();
 
 		~ShaderCache();
+
+	private:
+		// modules replaced by hotReloadCheck, whose dependents haven't been rebuilt yet
+		std::vector<ShaderModule*> replacedModules;
+		std::mutex reloadMutex;
+		// replaced modules that a pipeline build still uses. guarded by mutex.
+		std::vector<ShaderModule*> retiringModules;
+
+		// tables outgrown by the cache. a reader may still be probing one, so they live as long as the cache.
+		std::vector<ShaderTable*> retiredTables;
+		// variants being loaded right now, so concurrent misses don't compile the same shader twice
+		std::unordered_set<size_t> loading;
+		std::condition_variable loadFinished;
+
+		ShaderModule* load(const ShaderVariant& variant, size_t hash);
+		// makes a module visible to readers, returning the one it replaced. hold the mutex.
+		ShaderModule* publish(size_t hash, ShaderModule* module);
 	};
 
-	void hotReloadCheckingThread(ShaderCache* shaderCache, Semaphore* initiateReload, Semaphore* allowContinue, std::atomic<bool>* requestReloadFlag, std::atomic<bool>* reloadThreadKill);
+	void hotReloadCheckingThread(ShaderCache* shaderCache, std::atomic<bool>* reloadThreadKill);
 }
 
 namespace std {
@@ -0,0 +1,65 @@
+#include "ShaderCompiler.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include <shaderc/shaderc.hpp>
+
+#include "ShadercIncluder.h"
+
+namespace vku {
+	static shaderc_shader_kind getShaderKind(const std::string& path) {
+		size_t idx = path.rfind('.');
+		if (idx != std::string::npos) {
+			std::string ext = path.substr(idx + 1);
+			if (ext == "vert") return shaderc_glsl_vertex_shader;
+			else if (ext == "tesc") return shaderc_glsl_tess_control_shader;
+			else if (ext == "tese") return shaderc_glsl_tess_evaluation_shader;
+			else if (ext == "geom") return shaderc_glsl_geometry_shader;
+			else if (ext == "frag") return shaderc_glsl_fragment_shader;
+			else if (ext == "comp") return shaderc_glsl_compute_shader;
+		}
+
+		throw std::runtime_error("Error compiling shader, invalid filename: '" + path + "'");
+	}
+
+	std::vector<uint32_t> compileShader(const std::string& sourcePath, const std::map<std::string, std::string>& macros, std::string* errorMessage) {
+		std::ifstream file(sourcePath, std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("Shader source file not found: '" + sourcePath + "'");
+		}
+		std::string glslSource((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		shaderc_shader_kind shaderType = getShaderKind(sourcePath);
+
+		shaderc::Compiler compiler{};
+		shaderc::CompileOptions options{};
+
+		// hook #include api
+		ShadercIncluder* includer = new ShadercIncluder();
+		shaderc::CompileOptions::IncluderInterface* includerPtr = includer;
+		options.SetIncluder(std::unique_ptr<shaderc::CompileOptions::IncluderInterface>(includerPtr));
+
+		for (auto macro : macros) {
+			options.AddMacroDefinition(macro.first, macro.second);
+		}
+		options.SetWarningsAsErrors();
+		shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(glslSource, shaderType, sourcePath.c_str(), options);
+		if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+			if (errorMessage != nullptr) {
+				*errorMessage = result.GetErrorMessage();
+			}
+			throw std::runtime_error("Error compiling '" + sourcePath + "'");
+		}
+
+		return std::vector<uint32_t>(result.cbegin(), result.cend());
+	}
+
+	void writeSpirv(const std::string& spvPath, const std::vector<uint32_t>& spirvData) {
+		std::ofstream outStream(spvPath, std::ios::binary);
+		if (!outStream.is_open()) {
+			throw std::runtime_error("Failed to open '" + spvPath + "' for writing.");
+		}
+		outStream.write((char*)spirvData.data(), spirvData.size() * sizeof(uint32_t));
+	}
+}
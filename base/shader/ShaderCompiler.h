@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+// GLSL -> SPIR-V compilation through shaderc.
+// kept apart from ShaderCache so the runtime can be built without shaderc (NO_SHADERC), and so vkmerc-shaderbake can share it.
+namespace vku {
+	// compiles a GLSL source file, throwing on errors. the shader stage is derived from the file extension.
+	std::vector<uint32_t> compileShader(const std::string& sourcePath, const std::map<std::string, std::string>& macros, std::string* errorMessage = nullptr);
+
+	void writeSpirv(const std::string& spvPath, const std::vector<uint32_t>& spirvData);
+}
@@ -0,0 +1,115 @@
+#include "ShaderCompilerPool.h"
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <json.hpp>
+
+#include "../util/Subprocess.h"
+
+using json = nlohmann::json;
+
+namespace vku {
+	ShaderCompilerPool::ShaderCompilerPool(const std::string& workerPath, uint32_t workerCount, std::chrono::milliseconds timeout) {
+		this->workerPath = workerPath;
+		this->workerCount = workerCount > 0 ? workerCount : 1;
+		this->timeout = timeout;
+	}
+
+	ShaderCompilerPool::~ShaderCompilerPool() {
+		// closing the pipe is the workers' cue to exit, but don't count on it
+		for (Subprocess* worker : idle) {
+			delete worker;
+		}
+	}
+
+	Subprocess* ShaderCompilerPool::acquireWorker() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (idle.empty() && live >= workerCount) {
+			workerFreed.wait(lock);
+		}
+
+		if (!idle.empty()) {
+			Subprocess* worker = idle.back();
+			idle.pop_back();
+			return worker;
+		}
+
+		// workers start lazily, which is also how crashed ones get replaced
+		live++;
+		lock.unlock();
+		try {
+			return new Subprocess({ workerPath, "--worker" });
+		}
+		catch (const std::runtime_error& e) {
+			releaseWorker(nullptr, false);
+			throw;
+		}
+	}
+
+	void ShaderCompilerPool::releaseWorker(Subprocess* worker, bool healthy) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (healthy) {
+				idle.push_back(worker);
+			}
+			else {
+				live--;
+			}
+		}
+		workerFreed.notify_one();
+		if (!healthy) {
+			delete worker;
+		}
+	}
+
+	std::vector<uint32_t> ShaderCompilerPool::compile(const std::string& sourcePath, const std::map<std::string, std::string>& macros, const std::string& spvPath) {
+		json request;
+		request["source"] = sourcePath;
+		request["spv"] = spvPath;
+		request["macros"] = macros;
+
+		Subprocess* worker = acquireWorker();
+
+		json response;
+		try {
+			worker->writeLine(request.dump());
+
+			std::string line;
+			if (!worker->readLine(line, timeout)) {
+				throw std::runtime_error("Shader compiler worker timed out on '" + sourcePath + "'!");
+			}
+			response = json::parse(line);
+			if (!response.is_object() || response.find("ok") == response.end() || !response["ok"].is_boolean()) {
+				throw std::runtime_error("Malformed response from shader compiler worker!");
+			}
+		}
+		catch (const std::exception& e) {
+			// crashed, hung, or talking nonsense. either way it gets replaced.
+			std::cerr << "Restarting shader compiler worker: " << e.what() << std::endl;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				restarts++;
+			}
+			releaseWorker(worker, false);
+			throw std::runtime_error("Failed to compile '" + sourcePath + "' in a worker process!");
+		}
+		releaseWorker(worker, true);
+
+		if (!response["ok"].get<bool>()) {
+			auto error = response.find("error");
+			throw std::runtime_error(error != response.end() && error->is_string() ? error->get<std::string>() : "Failed to compile '" + sourcePath + "'!");
+		}
+
+		std::ifstream file(spvPath, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open file!");
+		}
+		size_t fileSize = static_cast<size_t>(file.tellg());
+		std::vector<uint32_t> spirv(fileSize / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(spirv.data()), fileSize);
+		return spirv;
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace vku {
+	struct Subprocess;
+
+	// compiles shaders in `vkmerc-shaderbake --worker` processes, so a compiler crash or hang can't take the engine down,
+	// and shaderc never has to be loaded into it. safe to use from several threads, which then compile in parallel.
+	//
+	// the protocol is one json object per line. requests are { "source": path, "spv": path, "macros": { ... } },
+	// the worker writes the SPIR-V to "spv" and answers { "ok": true }, or { "ok": false, "error": message }.
+	struct ShaderCompilerPool {
+		// worker processes are restarted after crashing or timing out
+		uint32_t restarts = 0;
+
+		ShaderCompilerPool(const std::string& workerPath, uint32_t workerCount, std::chrono::milliseconds timeout = std::chrono::seconds(30));
+		~ShaderCompilerPool();
+
+		// compiles in a worker and writes the result to spvPath, throwing if it fails, times out or the worker dies
+		std::vector<uint32_t> compile(const std::string& sourcePath, const std::map<std::string, std::string>& macros, const std::string& spvPath);
+
+	private:
+		std::string workerPath;
+		uint32_t workerCount;
+		std::chrono::milliseconds timeout;
+
+		std::mutex mutex;
+		std::condition_variable workerFreed;
+		std::vector<Subprocess*> idle;
+		// started workers, idle or busy
+		uint32_t live = 0;
+
+		Subprocess* acquireWorker();
+		void releaseWorker(Subprocess* worker, bool healthy);
+	};
+}
@@ -0,0 +1,50 @@
+#include "ShaderManifest.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#include <json.hpp>
+
+namespace vku {
+	std::vector<ShaderVariant> readShaderManifest(const std::string& path) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open shader manifest '" + path + "'");
+		}
+
+		nlohmann::json manifest;
+		try {
+			file >> manifest;
+		}
+		catch (const nlohmann::json::exception& e) {
+			throw std::runtime_error("Invalid shader manifest '" + path + "': " + e.what());
+		}
+		if (!manifest.is_array()) {
+			throw std::runtime_error("Invalid shader manifest '" + path + "': expected a list of variants");
+		}
+
+		std::vector<ShaderVariant> variants;
+		for (const nlohmann::json& entry : manifest) {
+			ShaderVariant variant{};
+			variant.name = entry.at("name").get<std::string>();
+			if (entry.find("macros") != entry.end()) {
+				variant.macros = entry.at("macros").get<std::map<std::string, std::string>>();
+			}
+			variants.push_back(variant);
+		}
+		return variants;
+	}
+
+	void writeShaderManifest(const std::string& path, const std::vector<ShaderVariant>& variants) {
+		nlohmann::json manifest = nlohmann::json::array();
+		for (const ShaderVariant& variant : variants) {
+			manifest.push_back({ { "name", variant.name }, { "macros", variant.macros } });
+		}
+
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open '" + path + "' for writing.");
+		}
+		file << manifest.dump(1, '\t') << std::endl;
+	}
+}
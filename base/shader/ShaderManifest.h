@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ShaderVariant.h"
+
+// a list of shader variants stored as json: [{ "name": "pbr/pbr_gbuf.frag", "macros": { "TEXTURELESS": "" } }, ...]
+// this is both the input to vkmerc-shaderbake, and the usage log the ShaderCache writes on exit.
+namespace vku {
+	std::vector<ShaderVariant> readShaderManifest(const std::string& path);
+	void writeShaderManifest(const std::string& path, const std::vector<ShaderVariant>& variants);
+}
@@ -2,8 +2,12 @@
 
 #include <vector>
 #include <stdexcept>
+#include <algorithm>
+
+#include <spirv_cross/spirv_glsl.hpp>
 
 #include "../VulkanDevice.h"
+#include "ShaderCache.h"
 
 namespace vku {
 	ShaderModule::ShaderModule(VulkanDevice* device, std::vector<uint32_t> data, VkShaderStageFlagBits shaderStageFlag) {
@@ -20,10 +24,12 @@ namespace vku {
 		}
 
 		this->shaderStageFlag = shaderStageFlag;
-	}
 
-	void ShaderModule::registerHotReloadCallback(ShaderCacheHotReloadCallback callback) {
-		hotReloadCallbacks.push_back(callback);
+		// reflect specialization constants, so materials can refer to them by name
+		spirv_cross::CompilerGLSL glsl(data);
+		for (const spirv_cross::SpecializationConstant& constant : glsl.get_specialization_constants()) {
+			specializationConstantIds[glsl.get_name(constant.id)] = constant.constant_id;
+		}
 	}
 
 	VkPipelineShaderStageCreateInfo ShaderModule::getStageInfo() {
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <string>
 #include <functional>
 
 #include <vulkan/vulkan.h>
@@ -17,11 +19,14 @@ namespace vku {
 		VkShaderStageFlagBits shaderStageFlag;
 		ShaderVariant info;
 		std::vector<uint32_t> spirvData;
+		// constant_id of every specialization constant, by name
+		std::map<std::string, uint32_t> specializationConstantIds;
 
 		std::vector<ShaderCacheHotReloadCallback> hotReloadCallbacks;
+		// pipeline builds using this module right now. a replaced module isn't destroyed until they're done. guarded by the cache's mutex.
+		uint32_t buildsInProgress = 0;
 
 		ShaderModule(VulkanDevice* device, std::vector<uint32_t> data, VkShaderStageFlagBits shaderStageFlag);
-		void registerHotReloadCallback(ShaderCacheHotReloadCallback callback);
 		VkPipelineShaderStageCreateInfo getStageInfo();
 		~ShaderModule();
 
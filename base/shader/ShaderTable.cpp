@@ -0,0 +1,58 @@
+#include "ShaderTable.h"
+
+namespace vku {
+	ShaderTable::ShaderTable(size_t capacity) : capacity(capacity) {
+		slots = std::make_unique<Slot[]>(capacity);
+	}
+
+	size_t ShaderTable::firstSlot(size_t hash) const {
+		// variant hashes aren't well distributed in the low bits, so mix them first
+		uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+		return static_cast<size_t>(mixed ^ (mixed >> 32)) & (capacity - 1);
+	}
+
+	ShaderModule* ShaderTable::find(size_t hash) const {
+		// terminates, since the table is never more than half full
+		for (size_t i = firstSlot(hash);; i = (i + 1) & (capacity - 1)) {
+			ShaderModule* module = slots[i].module.load(std::memory_order_acquire);
+			if (module == nullptr) {
+				return nullptr;
+			}
+			if (slots[i].hash.load(std::memory_order_relaxed) == hash) {
+				return module;
+			}
+		}
+	}
+
+	ShaderModule* ShaderTable::store(size_t hash, ShaderModule* module) {
+		for (size_t i = firstSlot(hash);; i = (i + 1) & (capacity - 1)) {
+			ShaderModule* existing = slots[i].module.load(std::memory_order_relaxed);
+			if (existing == nullptr) {
+				slots[i].hash.store(hash, std::memory_order_relaxed);
+				slots[i].module.store(module, std::memory_order_release);
+				count++;
+				return nullptr;
+			}
+			if (slots[i].hash.load(std::memory_order_relaxed) == hash) {
+				slots[i].module.store(module, std::memory_order_release);
+				return existing;
+			}
+		}
+	}
+
+	bool ShaderTable::full() const {
+		return (count + 1) * 2 > capacity;
+	}
+
+	std::vector<std::pair<size_t, ShaderModule*>> ShaderTable::entries() const {
+		std::vector<std::pair<size_t, ShaderModule*>> result;
+		result.reserve(count);
+		for (size_t i = 0; i < capacity; i++) {
+			ShaderModule* module = slots[i].module.load(std::memory_order_acquire);
+			if (module != nullptr) {
+				result.push_back({ slots[i].hash.load(std::memory_order_relaxed), module });
+			}
+		}
+		return result;
+	}
+}
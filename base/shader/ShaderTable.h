@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+
+namespace vku {
+	struct ShaderModule;
+
+	// fixed capacity, insert-only hash table from variant hash to module.
+	// lookups are wait-free and may run concurrently with a single writer; writers must be serialized externally.
+	// entries are never removed, only replaced, so a reader never sees a slot being torn down.
+	struct ShaderTable {
+		const size_t capacity;
+		size_t count = 0;
+
+		// capacity must be a power of two
+		ShaderTable(size_t capacity);
+
+		ShaderModule* find(size_t hash) const;
+		// inserts or replaces, returning the module that was replaced (if any). writers only.
+		ShaderModule* store(size_t hash, ShaderModule* module);
+
+		// whether one more entry would push the load factor past one half. writers grow into a larger table then.
+		bool full() const;
+
+		std::vector<std::pair<size_t, ShaderModule*>> entries() const;
+
+	private:
+		struct Slot {
+			std::atomic<size_t> hash{ 0 };
+			// published last, a non-null module marks the slot as occupied
+			std::atomic<ShaderModule*> module{ nullptr };
+		};
+
+		std::unique_ptr<Slot[]> slots;
+
+		size_t firstSlot(size_t hash) const;
+	};
+}
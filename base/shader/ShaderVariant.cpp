@@ -1,6 +1,7 @@
 #include "ShaderVariant.h"
 
 #include <string>
+#include <sstream>
 
 namespace vku {
 	size_t ShaderVariant::getHashcode() const {
@@ -12,4 +13,11 @@ namespace vku {
 		}
 		return hash;
 	}
+
+	std::string ShaderVariant::getSpirvPath(const std::string& shaderDirectory) const {
+		// convert hashcode to hex
+		std::stringstream stream;
+		stream << std::hex << getHashcode();
+		return shaderDirectory + name + "." + stream.str() + ".spv";
+	}
 }
\ No newline at end of file
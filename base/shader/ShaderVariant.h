@@ -2,11 +2,33 @@
 
 #include <string>
 #include <map>
+#include <cstdint>
+#include <cstring>
 
 namespace vku {
+	// the 32 bits of a bool, int, uint or float specialization constant
+	struct SpecializationConstant {
+		uint32_t bits = 0;
+
+		SpecializationConstant() = default;
+		SpecializationConstant(bool value) : bits(value ? 1u : 0u) {}
+		SpecializationConstant(int32_t value) { memcpy(&bits, &value, sizeof(bits)); }
+		SpecializationConstant(uint32_t value) : bits(value) {}
+		SpecializationConstant(float value) { memcpy(&bits, &value, sizeof(bits)); }
+
+		bool operator==(const SpecializationConstant& other) const { return bits == other.bits; }
+	};
+
 	struct ShaderVariant {
 		std::string name;
 		std::map<std::string, std::string> macros;
+		// values for the shader's `layout(constant_id = N) const` declarations, matched by name.
+		// applied when the pipeline is created, so unlike macros they share one SPIR-V module and don't affect the hash.
+		std::map<std::string, SpecializationConstant> constants;
+
 		size_t getHashcode() const;
+
+		// where the compiled SPIR-V of this variant lives, eg. 'res/shaders/pbr/pbr_gbuf.frag.1a2b3c.spv'
+		std::string getSpirvPath(const std::string& shaderDirectory) const;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "DeletionQueue.h"
+
+namespace vku {
+	void DeletionQueue::push(std::function<void()> destructor) {
+		std::lock_guard<std::mutex> lock(mutex);
+		// the frame being recorded right now may still use the object, so wait for that one as well
+		entries.push_back({ submitted + 1, std::move(destructor) });
+	}
+
+	void DeletionQueue::frameSubmitted() {
+		std::lock_guard<std::mutex> lock(mutex);
+		submitted++;
+	}
+
+	void DeletionQueue::collect(uint32_t framesInFlight) {
+		std::deque<Entry> ready;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (submitted < framesInFlight) {
+				return;
+			}
+
+			// frames use their fences round-robin, so the fence just waited on belongs to this submission
+			uint64_t completed = submitted - framesInFlight + 1;
+			while (!entries.empty() && entries.front().frame <= completed) {
+				ready.push_back(std::move(entries.front()));
+				entries.pop_front();
+			}
+		}
+		// destructors may push more entries, so run them outside the lock
+		run(ready);
+	}
+
+	void DeletionQueue::flush() {
+		while (true) {
+			std::deque<Entry> ready;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (entries.empty()) {
+					return;
+				}
+				ready.swap(entries);
+			}
+			run(ready);
+		}
+	}
+
+	void DeletionQueue::run(std::deque<Entry>& ready) {
+		for (Entry& entry : ready) {
+			entry.destructor();
+		}
+	}
+
+	DeletionQueue::~DeletionQueue() {
+		flush();
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace vku {
+	// defers destruction of gpu objects until no frame in flight can still reference them,
+	// so they can be retired mid-session without idling the queues. thread safe.
+	struct DeletionQueue {
+		// queue a destructor. it runs once every frame submitted so far, and the one currently being recorded, has finished.
+		void push(std::function<void()> destructor);
+
+		// call right after a frame's command buffer was submitted
+		void frameSubmitted();
+		// call after waiting on the in-flight fence of the next frame, with the number of frames in flight.
+		// runs every destructor that frame's fence covers.
+		void collect(uint32_t framesInFlight);
+		// run everything. only call once the device is idle.
+		void flush();
+
+		~DeletionQueue();
+
+	private:
+		struct Entry {
+			// submission after which the object is unused
+			uint64_t frame;
+			std::function<void()> destructor;
+		};
+
+		std::mutex mutex;
+		std::deque<Entry> entries;
+		uint64_t submitted = 0;
+
+		void run(std::deque<Entry>& ready);
+	};
+}
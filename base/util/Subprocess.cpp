@@ -0,0 +1,247 @@
+#include "Subprocess.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+namespace vku {
+	bool Subprocess::takeLine(std::string& line) {
+		size_t end = pending.find('\n');
+		if (end == std::string::npos) {
+			return false;
+		}
+		line = pending.substr(0, end);
+		pending.erase(0, end + 1);
+		// children on windows write text mode newlines
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		return true;
+	}
+
+#ifdef _WIN32
+	Subprocess::Subprocess(const std::vector<std::string>& args) {
+		SECURITY_ATTRIBUTES inherit{};
+		inherit.nLength = sizeof(inherit);
+		inherit.bInheritHandle = TRUE;
+
+		HANDLE stdinRead, stdoutWrite;
+		if (!CreatePipe(&stdinRead, reinterpret_cast<HANDLE*>(&stdinWrite), &inherit, 0)) {
+			throw std::runtime_error("Failed to create pipe!");
+		}
+		if (!CreatePipe(reinterpret_cast<HANDLE*>(&stdoutRead), &stdoutWrite, &inherit, 0)) {
+			CloseHandle(stdinRead);
+			CloseHandle(stdinWrite);
+			throw std::runtime_error("Failed to create pipe!");
+		}
+		// only the child's ends are inherited
+		SetHandleInformation(stdinWrite, HANDLE_FLAG_INHERIT, 0);
+		SetHandleInformation(stdoutRead, HANDLE_FLAG_INHERIT, 0);
+
+		std::string commandLine;
+		for (const std::string& arg : args) {
+			if (!commandLine.empty()) {
+				commandLine += " ";
+			}
+			commandLine += "\"" + arg + "\"";
+		}
+
+		STARTUPINFOA startupInfo{};
+		startupInfo.cb = sizeof(startupInfo);
+		startupInfo.dwFlags = STARTF_USESTDHANDLES;
+		startupInfo.hStdInput = stdinRead;
+		startupInfo.hStdOutput = stdoutWrite;
+		startupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+		PROCESS_INFORMATION processInfo{};
+		BOOL created = CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &startupInfo, &processInfo);
+		CloseHandle(stdinRead);
+		CloseHandle(stdoutWrite);
+		if (!created) {
+			CloseHandle(stdinWrite);
+			CloseHandle(stdoutRead);
+			throw std::runtime_error("Failed to start '" + args[0] + "'!");
+		}
+		CloseHandle(processInfo.hThread);
+		process = processInfo.hProcess;
+	}
+
+	Subprocess::~Subprocess() {
+		kill();
+		CloseHandle(stdinWrite);
+		CloseHandle(stdoutRead);
+		CloseHandle(process);
+	}
+
+	bool Subprocess::running() {
+		return WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+	}
+
+	void Subprocess::writeLine(const std::string& line) {
+		std::string data = line + "\n";
+		DWORD written;
+		if (!WriteFile(stdinWrite, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) || written != data.size()) {
+			throw std::runtime_error("Failed to write to subprocess!");
+		}
+	}
+
+	bool Subprocess::readLine(std::string& line, std::chrono::milliseconds timeout) {
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (!takeLine(line)) {
+			// anonymous pipes can't wait with a timeout, so poll
+			DWORD available = 0;
+			if (!PeekNamedPipe(stdoutRead, nullptr, 0, nullptr, &available, nullptr)) {
+				throw std::runtime_error("Subprocess closed its output!");
+			}
+			if (available == 0) {
+				if (std::chrono::steady_clock::now() >= deadline) {
+					return false;
+				}
+				Sleep(1);
+				continue;
+			}
+
+			char buffer[4096];
+			DWORD read;
+			if (!ReadFile(stdoutRead, buffer, std::min<DWORD>(available, sizeof(buffer)), &read, nullptr) || read == 0) {
+				throw std::runtime_error("Subprocess closed its output!");
+			}
+			pending.append(buffer, read);
+		}
+		return true;
+	}
+
+	void Subprocess::kill() {
+		if (running()) {
+			TerminateProcess(process, 1);
+		}
+		WaitForSingleObject(process, INFINITE);
+	}
+#else
+	Subprocess::Subprocess(const std::vector<std::string>& args) {
+		int sockets[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+			throw std::runtime_error("Failed to create socket pair!");
+		}
+#ifdef __APPLE__
+		// there is no MSG_NOSIGNAL, so turn off SIGPIPE on the socket itself
+		int noSigPipe = 1;
+		setsockopt(sockets[0], SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+		fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+
+		std::vector<char*> argv;
+		for (const std::string& arg : args) {
+			argv.push_back(const_cast<char*>(arg.c_str()));
+		}
+		argv.push_back(nullptr);
+
+		pid = fork();
+		if (pid < 0) {
+			close(sockets[0]);
+			close(sockets[1]);
+			throw std::runtime_error("Failed to start '" + args[0] + "'!");
+		}
+		if (pid == 0) {
+			dup2(sockets[1], STDIN_FILENO);
+			dup2(sockets[1], STDOUT_FILENO);
+			close(sockets[0]);
+			close(sockets[1]);
+			execvp(argv[0], argv.data());
+			_exit(127);
+		}
+
+		close(sockets[1]);
+		fd = sockets[0];
+	}
+
+	Subprocess::~Subprocess() {
+		kill();
+		close(fd);
+	}
+
+	bool Subprocess::running() {
+		if (pid < 0) {
+			return false;
+		}
+		int status;
+		if (waitpid(pid, &status, WNOHANG) == 0) {
+			return true;
+		}
+		pid = -1;
+		return false;
+	}
+
+	void Subprocess::writeLine(const std::string& line) {
+		std::string data = line + "\n";
+		size_t offset = 0;
+		while (offset < data.size()) {
+#ifdef MSG_NOSIGNAL
+			ssize_t written = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+#else
+			ssize_t written = send(fd, data.data() + offset, data.size() - offset, 0);
+#endif
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::runtime_error("Failed to write to subprocess!");
+			}
+			offset += written;
+		}
+	}
+
+	bool Subprocess::readLine(std::string& line, std::chrono::milliseconds timeout) {
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (!takeLine(line)) {
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+			if (remaining.count() <= 0) {
+				return false;
+			}
+
+			pollfd pfd{ fd, POLLIN, 0 };
+			int ready = poll(&pfd, 1, static_cast<int>(remaining.count()));
+			if (ready < 0 && errno != EINTR) {
+				throw std::runtime_error("Failed to read from subprocess!");
+			}
+			if (ready <= 0) {
+				continue;
+			}
+
+			char buffer[4096];
+			ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+			if (received < 0 && errno == EINTR) {
+				continue;
+			}
+			if (received <= 0) {
+				throw std::runtime_error("Subprocess closed its output!");
+			}
+			pending.append(buffer, received);
+		}
+		return true;
+	}
+
+	void Subprocess::kill() {
+		if (pid < 0) {
+			return;
+		}
+		::kill(pid, SIGKILL);
+		int status;
+		waitpid(pid, &status, 0);
+		pid = -1;
+	}
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+namespace vku {
+	// a child process whose stdin / stdout are connected to us, for line based request / response protocols.
+	// not thread safe; one user at a time.
+	struct Subprocess {
+		// args[0] is the executable, searched on the PATH. throws if the process can't be started.
+		Subprocess(const std::vector<std::string>& args);
+		~Subprocess();
+
+		bool running();
+
+		// throws if the process has gone away
+		void writeLine(const std::string& line);
+		// returns false on timeout, throws if the process closed its stdout
+		bool readLine(std::string& line, std::chrono::milliseconds timeout);
+
+		void kill();
+
+	private:
+#ifdef _WIN32
+		void* process = nullptr;
+		void* stdinWrite = nullptr;
+		void* stdoutRead = nullptr;
+#else
+		int pid = -1;
+		// one end of a socketpair, used for both directions
+		int fd = -1;
+#endif
+		// output read past the last returned line
+		std::string pending;
+
+		bool takeLine(std::string& line);
+	};
+}
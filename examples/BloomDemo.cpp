@@ -5,6 +5,7 @@
 #include <VulkanDevice.h>
 #include <VulkanSwapchain.h>
 #include <VulkanTexture.h>
+#include <SamplerCache.h>
 #include <VulkanDescriptorSet.h>
 #include <VulkanMesh.h>
 #include <VulkanMaterial.h>
@@ -100,7 +101,7 @@ public:
 		skybox->image->writeImageViewInfo(&viewInfo);
 		viewInfo.imageViewType = VK_IMAGE_VIEW_TYPE_CUBE;
 		skybox->view = new VulkanImageView(context->device, viewInfo);
-		skybox->sampler = new VulkanSampler(context->device, {});
+		skybox->sampler = context->device->samplerCache->get({});
 
 		flycam = new OrbitCam(context->windowHandle);
 
@@ -233,11 +234,13 @@ public:
 		VkExtent2D swapchainExtent = context->device->swapchain->swapChainExtent;
 		global.proj = flycam->getProjMatrix(static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height), n, f);
 		global.camPos = transform * glm::vec4(0.0, 0.0, 0.0, 1.0);
+		scene->sortOrigin = glm::vec3(global.camPos);
 		global.screenRes = { swapchainExtent.width, swapchainExtent.height };
 		global.time = time;
 		global.directionalLight = glm::rotate(glm::mat4(1.0), time, glm::vec3(0.0, 1.0, 0.0)) * glm::vec4(1.0, -1.0, 0.0, 0.0);
 
 		scene->updateUniforms(i, 0, &global);
+		scene->updateObjects(i);
 
 		blurXUniform->write(&blurX);
 		blurYUniform->write(&blurY);
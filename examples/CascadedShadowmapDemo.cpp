@@ -7,6 +7,7 @@
 #include <VulkanDevice.h>
 #include <VulkanSwapchain.h>
 #include <VulkanTexture.h>
+#include <SamplerCache.h>
 #include <VulkanDescriptorSet.h>
 #include <VulkanMesh.h>
 #include <VulkanMaterial.h>
@@ -119,7 +120,7 @@ public:
 		skybox->image->writeImageViewInfo(&viewInfo);
 		viewInfo.imageViewType = VK_IMAGE_VIEW_TYPE_CUBE;
 		skybox->view = new VulkanImageView(context->device, viewInfo);
-		skybox->sampler = new VulkanSampler(context->device, {});
+		skybox->sampler = context->device->samplerCache->get({});
 
 		flycam = new FlyCam(context->windowHandle);
 
@@ -143,7 +144,7 @@ public:
 						if (cascadeIndex <= 3) {
 							viewport.y = y * SHADOWMAP_CASCADE_SIZE;
 							vkCmdSetViewport(cb, 0, 1, &viewport);
-							vkCmdPushConstants(cb, mat->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), sizeof(glm::uint), &cascadeIndex);
+							vkCmdPushConstants(cb, mat->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t), sizeof(glm::uint), &cascadeIndex);
 							scene->render(cb, i, true);
 							cascadeIndex++;
 						}
@@ -239,7 +240,7 @@ public:
 		irradiancemap = generateIrradianceCube(context->device, skybox);
 		specmap = generatePrefilteredCube(context->device, skybox);
 
-		std::map<std::string,std::string> pbrMacros = { { "AMBIENT_FACTOR", "0.3" }, {"USE_CASCADES", ""}, {"SUN_STRENGTH", "0.5" } };
+		std::map<std::string,std::string> pbrMacros = { {"USE_CASCADES", ""} };
 		city = new VulkanObjModel("res/models/city.obj", scene, mainPass, specmap, irradiancemap, brdf, pbrMacros);
 		city->localTransform *= glm::translate(glm::vec3(0, -2, 0));
 		scene->addObject(city);
@@ -345,6 +346,7 @@ public:
 		global.view = glm::inverse(transform);
 		global.proj = flycam->getProjMatrix(width, height, 0.05f, 500.0);
 		global.camPos = transform * glm::vec4(0.0, 0.0, 0.0, 1.0);
+		scene->sortOrigin = glm::vec3(global.camPos);
 		global.screenRes = { swapchainExtent.width, swapchainExtent.height };
 		global.time = time;
 
@@ -387,6 +389,7 @@ public:
 
 		scene->updateUniforms(i, 0, &global);
 		scene->updateUniforms(i, 1, &cascades);
+		scene->updateObjects(i);
 	}
 
 	int timesDrawn = 0;
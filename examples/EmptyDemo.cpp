@@ -100,28 +100,41 @@ public:
 		VkExtent2D swapchainExtent = context->device->swapchain->swapChainExtent;
 		global.proj = flycam->getProjMatrix(static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height), n, f);
 		global.camPos = transform * glm::vec4(0.0, 0.0, 0.0, 1.0);
+		scene->sortOrigin = glm::vec3(global.camPos);
 		global.screenRes = { swapchainExtent.width, swapchainExtent.height };
 		global.time = time;
 
 		scene->updateUniforms(i, 0, &global);
+		scene->updateObjects(i);
 	}
 
 	VkCommandBuffer draw(uint32_t i)
 	{
 		updateUniforms(i);
 
+		// recorded once, so a reloaded shader or a finished pipeline build needs a new recording.
+		// the engine waited for this image's last frame, so the buffer isn't in use.
+		if (graph->needsRecording(i)) {
+			recordCommandBuffer(i);
+		}
+
 		return cmdBufs[i];
 	}
+	void recordCommandBuffer(uint32_t i)
+	{
+		vkFreeCommandBuffers(*context->device, context->device->commandPool, 1, &cmdBufs[i]);
+		cmdBufs[i] = context->device->beginCommandBuffer();
+		graph->render(cmdBufs[i], i);
+		vkEndCommandBuffer(cmdBufs[i]);
+	}
 	void buildSwapchainDependants()
 	{
 		graph->createInstances();
 
 		vkFreeCommandBuffers(*context->device, context->device->commandPool, static_cast<uint32_t>(cmdBufs.size()), cmdBufs.data());
-		cmdBufs.resize(context->device->swapchain->swapChainLength);
+		cmdBufs.assign(context->device->swapchain->swapChainLength, VK_NULL_HANDLE);
 		for (uint32_t i = 0; i < cmdBufs.size(); i++) {
-			cmdBufs[i] = context->device->beginCommandBuffer();
-			graph->render(cmdBufs[i], i);
-			vkEndCommandBuffer(cmdBufs[i]);
+			recordCommandBuffer(i);
 		}
 	}
 	void destroySwapchainDependents()
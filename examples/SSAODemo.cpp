@@ -22,9 +22,11 @@
 #include <pbr/VulkanObjModel.h>
 #include <pbr/Ue4BrdfLut.hpp>
 #include <pbr/CubemapFiltering.hpp>
+#include <pbr/PbrMaterial.h>
 
 #include <rendergraph/RenderGraph.h>
 #include <scene/Scene.h>
+#include <scene/ObjectBuffer.h>
 #include <BaseEngine.h>
 
 #include <util/FlyCam.h>
@@ -71,6 +73,8 @@ public:
 
 	VulkanObjModel* platform;
 	VulkanGltfModel* gltf;
+	// drawn in place of Sponza's materials until their pipelines are built
+	TexturelessPbrMaterial* fallback;
 	VulkanTexture* brdf;
 	VulkanTexture* irradiancemap;
 	VulkanTexture* specmap;
@@ -117,18 +121,28 @@ public:
 	struct Light : Object {
 		VulkanMeshBuffer *meshBuf;
 		Pass* pass;
-		Light(VulkanDevice* device, Pass *pass) {
-			meshBuf = new VulkanMeshBuffer(device, vku::sphere);
+		uint32_t objectIndex;
+		Light(Scene* scene, Pass *pass) {
+			this->scene = scene;
+			meshBuf = new VulkanMeshBuffer(scene->device, vku::sphere);
 			this->pass = pass;
+			objectIndex = scene->objectBuffer->allocate();
+			(*scene->objectBuffer)[objectIndex].boundsMin = glm::vec3(-1.0f);
+			(*scene->objectBuffer)[objectIndex].boundsMax = glm::vec3(1.0f);
 		}
 		~Light() {
+			scene->objectBuffer->free(objectIndex);
 			delete meshBuf;
 		}
 		virtual void render(VkCommandBuffer cmdBuf, uint32_t swapIdx, bool noMaterial) override
 		{
-			vkCmdPushConstants(cmdBuf, this->pass->material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &this->localTransform);
+			scene->pushObjectIndex(cmdBuf, objectIndex);
 			meshBuf->draw(cmdBuf);
 		}
+		virtual void updateObjectData() override
+		{
+			(*scene->objectBuffer)[objectIndex].transform = localTransform;
+		}
 		virtual glm::mat4 getAABBTransform() override
 		{
 			return glm::mat4();
@@ -136,7 +150,7 @@ public:
 	};
 
 	void initLights(Scene* scene, Pass * lights) {
-		auto x = new Light(context->device, lights);
+		auto x = new Light(scene, lights);
 		scene->addObject(x);
 		x->layer = 1 << 3; // light layer
 		x->localTransform = glm::scale(glm::vec3(30.0,30.0,30.0));
@@ -146,6 +160,8 @@ public:
 	void postInit()
 	{
 		SceneInfo sInfo{};
+		// Sponza is a few hundred draws, most of them off screen or behind a wall
+		sInfo.gpuCulling = true;
 		scene = new Scene(context->device, sInfo);
 
 		flycam = new FlyCam(context->windowHandle);
@@ -199,6 +215,7 @@ public:
 
 			PassSchema* main = graphSchema->pass("main");
 			main->layerMask = 1 << 0;
+			main->gpuCulled = true;
 
 			PassSchema* ssao = graphSchema->blitPass("ssao", { "ssao/ssao.frag", {} });
 			ssao->layerMask = 0;
@@ -327,7 +344,10 @@ public:
 		gltf->localTransform *= glm::translate(glm::vec3(0, 0.8, 0));
 		scene->addObject(gltf);
 
-		scene->addObject(new VulkanGltfModel("res/models/Sponza/glTF/Sponza.gltf", scene, mainPass));
+		// Sponza's pipelines build in the background, so loading it doesn't wait on the driver
+		fallback = new TexturelessPbrMaterial({ glm::vec4(0.5f, 0.5f, 0.5f, 1.0f), glm::vec4(0.0f), 0.0f, 1.0f }, scene, mainPass);
+		mainPass->fallbackMaterial = fallback->matInstance;
+		scene->addObject(new VulkanGltfModel("res/models/Sponza/glTF/Sponza.gltf", scene, mainPass, {}, true));
 
 		cmdBufs.resize(context->device->swapchain->swapChainLength);
 		for (uint32_t i = 0; i < cmdBufs.size(); i++) {
@@ -362,6 +382,7 @@ public:
 		global.view = glm::translate(jitter)* glm::inverse(transform);
 		global.proj = flycam->getProjMatrix(static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height), n, f);
 		global.camPos = transform * glm::vec4(0.0, 0.0, 0.0, 1.0);
+		scene->sortOrigin = glm::vec3(global.camPos);
 		global.screenRes = { swapchainExtent.width, swapchainExtent.height };
 		global.time = time;
 
@@ -370,6 +391,10 @@ public:
 		global.directionalLight = glm::rotate(glm::mat4(1.0f), lightAzimuth, glm::vec3(0.0, 1.0, 0.0)) * global.directionalLight;
 
 		scene->updateUniforms(i, 0, &global);
+		scene->updateObjects(i);
+		if (scene->gpuCulling != nullptr) {
+			scene->gpuCulling->update(i, global.view, global.proj);
+		}
 		ssao.nearPlane = n;
 		ssao.farPlane = f;
 		ssaoUniform->write(&ssao);
@@ -402,7 +427,11 @@ public:
 				ssao.intensity = 0.0;
 			ImGui::SliderInt("Blur Size", &ssaoHorizBlurParams.pixelStep, 0.f, 8.f);
 			ssaoVertiBlurParams.pixelStep = ssaoHorizBlurParams.pixelStep;
+			if (scene->gpuCulling != nullptr) {
+				ImGui::Text("GPU culling %u draws in %u indirect draws", scene->gpuCulling->recordedDraws, scene->gpuCulling->recordedBatches);
+			}
 			ImGui::End();
+			gui->MemoryWindow();
 			gui->InternalRender();
 		}
 
@@ -440,6 +469,8 @@ public:
 	{
 		destroySwapchainDependents();
 
+		mainPass->fallbackMaterial = nullptr;
+		delete fallback;
 		delete ssaoUniform;
 		delete ssaoHorizBlurUniform;
 		delete ssaoVertiBlurUniform;
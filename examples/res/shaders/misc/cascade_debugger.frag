@@ -10,7 +10,7 @@ layout(std140, binding = 0) uniform GlobalUniform {
 	float time;
 } global;
 
-layout(std140, binding = 1) uniform CascadesUniform {
+layout(std140, binding = 2) uniform CascadesUniform {
 	mat4 cascades[4];
 	vec4 data[4];
 	mat4 cameraFrust;
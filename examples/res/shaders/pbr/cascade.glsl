@@ -1,4 +1,4 @@
-layout(std140, binding = 1) uniform CascadesUniform {
+layout(std140, binding = 2) uniform CascadesUniform {
 	mat4 cascades[4];
 	vec4 data[4];
 	mat4 cameraFrust;
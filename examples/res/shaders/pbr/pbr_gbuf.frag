@@ -10,7 +10,32 @@ layout(std140, binding = 0) uniform GlobalUniform {
 	float time;
 } global;
 
-#ifndef TEXTURELESS
+#if defined(BINDLESS)
+#extension GL_EXT_nonuniform_qualifier : enable
+
+// the device-wide texture table, and the texture slots of every material in the model
+layout(set=3, binding=0) uniform sampler2D textures[];
+
+struct MaterialTextures {
+	uint albedo;
+	uint normal;
+	uint metalRough;
+	uint emissive;
+	uint ao;
+};
+layout(std430, set=2, binding=0) readonly buffer Materials {
+	MaterialTextures materials[];
+};
+
+// from the object buffer, passed along by the vertex shader
+layout(location = 5) flat in uint inMaterialIndex;
+
+#define tex_albedo textures[materials[inMaterialIndex].albedo]
+#define tex_normal textures[materials[inMaterialIndex].normal]
+#define tex_metal_rough textures[materials[inMaterialIndex].metalRough]
+#define tex_emissive textures[materials[inMaterialIndex].emissive]
+#define tex_ao textures[materials[inMaterialIndex].ao]
+#elif !defined(TEXTURELESS)
 layout(set=2, binding=0) uniform sampler2D tex_albedo;
 layout(set=2, binding=1) uniform sampler2D tex_normal;
 layout(set=2, binding=2) uniform sampler2D tex_metal_rough;
@@ -38,6 +63,10 @@ layout(location = 3) out vec3 outNormal;
 layout(location = 4) out vec3 outPosition;
 layout(location = 5) out float outAO;
 
+// alpha masking is specialized per material, so opaque pipelines never discard
+layout(constant_id = 0) const bool ALPHA_MASK = false;
+layout(constant_id = 1) const float ALPHA_CUTOFF = 0.5;
+
 #ifndef TEXTURELESS
 vec3 getNormal() {
 	vec3 normal      = normalize(inNormal);
@@ -53,11 +82,9 @@ void main()
 {
 #ifndef TEXTURELESS
 	vec4 col = texture(tex_albedo, inTexCoord).rgba;
-#ifdef ALPHA_CUTOFF
-	if(col.a < ALPHA_CUTOFF) {
+	if(ALPHA_MASK && col.a < ALPHA_CUTOFF) {
 		discard;
 	}
-#endif
 	outColor = vec4(col.rgb, 1.0);
 	outEmissive = vec4(pow(texture(tex_emissive, inTexCoord).rgb, vec3(2.2)), 1.0);
 
@@ -69,11 +96,9 @@ void main()
 	outNormal = getNormal();
 	outAO = texture(tex_ao, inTexCoord).r;
 #else
-#ifdef ALPHA_CUTOFF
-	if(col.a < ALPHA_CUTOFF) {
+	if(ALPHA_MASK && pbr.albedo.a < ALPHA_CUTOFF) {
 		discard;
 	}
-#endif
 	outColor = pbr.albedo;
 	outEmissive = pbr.emissive;
 
@@ -10,13 +10,15 @@ layout(std140, binding = 0) uniform GlobalUniform {
 	float time;
 } global;
 
-layout(std140, binding = 1) uniform CascadesUniform {
+layout(std140, binding = 2) uniform CascadesUniform {
 	mat4 cascades[4];
 	float biases[4];
 } cascades;
 
+#include "../scene/objects.glsl"
+
 layout(push_constant) uniform pushConstants {
-    mat4 transform;
+	uint objectIndex;
 } pc;
 
 layout(location = 0) in vec3 inPosition;
@@ -30,15 +32,22 @@ layout(location = 1) out vec3 fragColor;
 layout(location = 2) out vec2 fragTexCoord;
 layout(location = 3) out vec3 fragNormal;
 layout(location = 4) out vec4 fragTangent;
+#if defined(BINDLESS)
+layout(location = 5) flat out uint fragMaterialIndex;
+#endif
 
 void main() {
     fragColor = inColor;
     fragTexCoord = inTexCoord;
-    
-    fragPosition = (pc.transform * vec4(inPosition, 1.0)).xyz;
+
+    mat4 transform = objects[OBJECT_INDEX].transform;
+    fragPosition = (transform * vec4(inPosition, 1.0)).xyz;
 	
-    fragNormal = (pc.transform * vec4(inNormal, 0.0)).xyz;
+    fragNormal = (transform * vec4(inNormal, 0.0)).xyz;
     fragTangent = inTangent.xyzw;
+#if defined(BINDLESS)
+    fragMaterialIndex = objects[OBJECT_INDEX].materialIndex;
+#endif
 	
     gl_Position = global.proj * global.view * vec4(fragPosition, 1.0);
 }
\ No newline at end of file
@@ -25,6 +25,10 @@ layout(location = 0) in vec3 inPosition;
 
 layout(location = 0) out vec4 outLight;
 
+// lighting knobs, specialized at pipeline creation
+layout(constant_id = 0) const float SUN_STRENGTH = 1.0;
+layout(constant_id = 1) const float AMBIENT_FACTOR = 1.0;
+
 #ifdef USE_CASCADES
 #include "cascade.glsl"
 #endif
@@ -97,9 +101,7 @@ vec3 brdf(vec3 c, vec3 n, vec3 wo, vec3 wi, float m, float r, vec3 F0) {
 
 vec3 reflectance(vec3 c, vec3 p, vec3 n, vec3 wo, float m, float r, vec3 F0) {
 	vec3 sun = brdf(c, n, wo, -global.directionalLight.xyz, m, r, F0);
-#ifdef SUN_STRENGTH
 	sun *= SUN_STRENGTH;
-#endif
 	sun *= exposureToSun(p);
 	return sun;
 }
@@ -178,9 +180,7 @@ void main()
 		
 		vec3 ambient = (kD * diffuse + spec);
 
-#ifdef AMBIENT_FACTOR
 		ambient *= AMBIENT_FACTOR;
-#endif
 
 		outLight.rgb += ao*ambient;
 	}
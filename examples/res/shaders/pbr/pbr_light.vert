@@ -10,13 +10,15 @@ layout(std140, binding = 0) uniform GlobalUniform {
 	float time;
 } global;
 
-layout(std140, binding = 1) uniform CascadesUniform {
+layout(std140, binding = 2) uniform CascadesUniform {
 	mat4 cascades[4];
 	float biases[4];
 } cascades;
 
+#include "../scene/objects.glsl"
+
 layout(push_constant) uniform pushConstants {
-    mat4 transform;
+	uint objectIndex;
 } pc;
 
 layout(location = 0) in vec3 inPosition;
@@ -28,7 +30,7 @@ layout(location = 4) in vec4 inTangent;
 layout(location = 0) out vec3 fragPosition;
 
 void main() {
-    fragPosition = (pc.transform * vec4(inPosition, 1.0)).xyz;
+    fragPosition = (objects[OBJECT_INDEX].transform * vec4(inPosition, 1.0)).xyz;
 	
     gl_Position = global.proj * global.view * vec4(fragPosition, 1.0);
 }
\ No newline at end of file
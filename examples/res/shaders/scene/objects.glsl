@@ -0,0 +1,16 @@
+// per-object data, written by the engine's ObjectBuffer once per frame (set 0, binding 1)
+struct ObjectData {
+	mat4 transform;
+	mat4 prevTransform;
+	vec3 boundsMin;
+	uint materialIndex;
+	vec3 boundsMax;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer {
+	ObjectData objects[];
+};
+
+// draws culled on the GPU pass their object index as the first instance, everything else pushes it.
+// only for vertex shaders that declare pc.objectIndex.
+#define OBJECT_INDEX (gl_InstanceIndex != 0 ? uint(gl_InstanceIndex) : pc.objectIndex)
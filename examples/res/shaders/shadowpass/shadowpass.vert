@@ -10,13 +10,15 @@ layout(std140, binding = 0) uniform GlobalUniform {
 	float time;
 } global;
 
-layout(std140, binding = 1) uniform CascadesUniform {
+layout(std140, binding = 2) uniform CascadesUniform {
 	mat4 cascades[4];
 	float biases[4];
 } cascades;
 
+#include "../scene/objects.glsl"
+
 layout(push_constant) uniform pushConstants {
-    mat4 transform;
+	uint objectIndex;
 	uint cascade;
 } pc;
 
@@ -27,5 +29,5 @@ layout(location = 3) in vec3 in4;
 layout(location = 4) in vec4 in5;
 
 void main() {
-	gl_Position = cascades.cascades[pc.cascade] * pc.transform * vec4(inPosition, 1.0);
+	gl_Position = cascades.cascades[pc.cascade] * objects[OBJECT_INDEX].transform * vec4(inPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include <iostream>
+#include <stdexcept>
+
+#include "memory/RangeAllocator.h"
+
+using namespace vku;
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const char* what) {
+		if (!condition) {
+			std::cerr << "FAILED: " << what << std::endl;
+			failures++;
+		}
+	}
+
+	void allocateUntilFull() {
+		RangeAllocator ranges(256);
+		check(ranges.allocate(64) == 0, "first range starts at 0");
+		check(ranges.allocate(64) == 64, "ranges are handed out first fit");
+		check(ranges.allocate(128) == 128, "an exact fit uses up the rest");
+		check(ranges.used() == 256, "used counts every range");
+		check(ranges.freeRangeCount() == 0, "nothing is left free");
+		check(ranges.allocate(1) == RangeAllocator::INVALID, "a full allocator returns INVALID");
+	}
+
+	void freeAndReuse() {
+		RangeAllocator ranges(256);
+		uint64_t a = ranges.allocate(64);
+		uint64_t b = ranges.allocate(64);
+		ranges.free(a, 64);
+		check(ranges.used() == 64, "free gives the size back");
+		check(ranges.allocate(32) == a, "a freed hole is reused");
+		check(ranges.allocate(64) == b + 64, "a range too big for the hole goes after it");
+	}
+
+	void coalesce() {
+		RangeAllocator ranges(192);
+		uint64_t a = ranges.allocate(64);
+		uint64_t b = ranges.allocate(64);
+		uint64_t c = ranges.allocate(64);
+
+		// freeing a then c leaves two separate holes
+		ranges.free(a, 64);
+		ranges.free(c, 64);
+		check(ranges.freeRangeCount() == 2, "non-adjacent ranges stay separate");
+		check(ranges.largestFreeRange() == 64, "separate holes don't add up");
+
+		// b joins them with both neighbours
+		ranges.free(b, 64);
+		check(ranges.freeRangeCount() == 1, "a range merges with both neighbours");
+		check(ranges.largestFreeRange() == 192, "the merged range spans everything");
+		check(ranges.empty(), "everything is free again");
+		check(ranges.allocate(192) == 0, "the merged range can be allocated whole");
+	}
+
+	void alignment() {
+		RangeAllocator ranges(256);
+		check(ranges.allocate(3) == 0, "unaligned first range");
+		uint64_t aligned = ranges.allocate(16, 16);
+		check(aligned == 16, "the offset is rounded up to the alignment");
+		check(ranges.used() == 19, "padding isn't counted as used");
+		check(ranges.allocate(13) == 3, "padding in front of an aligned range stays free");
+		check(ranges.allocate(8, 0) == 32, "an alignment of 0 acts as 1");
+
+		RangeAllocator small(100);
+		check(small.allocate(64, 64) == 0, "aligned range at 0");
+		check(small.allocate(40, 64) == RangeAllocator::INVALID, "no aligned offset leaves room in the rest");
+		check(small.allocate(36) == 64, "the rest is still usable unaligned");
+	}
+
+	void grow() {
+		RangeAllocator ranges(0);
+		check(ranges.allocate(1) == RangeAllocator::INVALID, "an empty allocator has nothing to give");
+		ranges.grow(64);
+		uint64_t a = ranges.allocate(32);
+		ranges.grow(128);
+		check(ranges.freeRangeCount() == 1, "grown space merges with a free tail");
+		check(ranges.allocate(96) == a + 32, "a range can span the old and new capacity");
+		ranges.grow(64);
+		check(ranges.capacity() == 128, "grow never shrinks");
+	}
+
+	void misuse() {
+		RangeAllocator ranges(64);
+		bool threw = false;
+		try {
+			ranges.allocate(0);
+		}
+		catch (const std::runtime_error&) {
+			threw = true;
+		}
+		check(threw, "allocating an empty range throws");
+
+		threw = false;
+		try {
+			ranges.free(0, 8);
+		}
+		catch (const std::runtime_error&) {
+			threw = true;
+		}
+		check(threw, "freeing more than was allocated throws");
+
+		threw = false;
+		ranges.allocate(8);
+		try {
+			ranges.free(60, 8);
+		}
+		catch (const std::runtime_error&) {
+			threw = true;
+		}
+		check(threw, "freeing past the capacity throws");
+	}
+}
+
+int main() {
+	allocateUntilFull();
+	freeAndReuse();
+	coalesce();
+	alignment();
+	grow();
+	misuse();
+
+	if (failures > 0) {
+		std::cerr << failures << " check(s) failed." << std::endl;
+		return 1;
+	}
+	std::cout << "All RangeAllocator checks passed." << std::endl;
+	return 0;
+}
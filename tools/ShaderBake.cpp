@@ -0,0 +1,226 @@
+// vkmerc-shaderbake: compiles every shader variant in one or more manifests ahead of time.
+// manifests can be written by hand, or be the usage log (shader_usage.json) the ShaderCache writes on exit.
+// the output lands next to the sources, exactly where the runtime ShaderCache looks for it.
+// with --embed, the SPIR-V is written into a C++ source file instead, for the EMBED_SHADERS build.
+// with --worker, it instead serves compile requests from the engine's ShaderCompilerPool.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <json.hpp>
+
+#include "shader/ShaderVariant.h"
+#include "shader/ShaderManifest.h"
+#include "shader/ShaderCompiler.h"
+
+using namespace vku;
+using json = nlohmann::json;
+
+static void printUsage() {
+	std::cout << "usage: vkmerc-shaderbake [options] <manifest.json>..." << std::endl
+		<< "  -s, --shaders <dir>  shader source directory, also where .spv files are written (default: res/shaders/)" << std::endl
+		<< "  -j, --jobs <n>       number of parallel compile jobs (default: number of hardware threads)" << std::endl
+		<< "  --embed <file.cpp>   write the SPIR-V into a C++ source file rather than .spv files" << std::endl
+		<< "  --worker             serve compile requests on stdin / stdout (see ShaderCompilerPool.h)" << std::endl;
+}
+
+// writes the table declared in shader/EmbeddedShaders.h. variants must be sorted by hash.
+static bool writeEmbeddedShaders(const std::string& path, const std::vector<ShaderVariant>& variants, const std::vector<std::vector<uint32_t>>& spirv) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Failed to open '" << path << "' for writing." << std::endl;
+		return false;
+	}
+
+	file << "// generated by vkmerc-shaderbake --embed, do not edit" << std::endl << std::endl
+		<< "#include \"shader/EmbeddedShaders.h\"" << std::endl << std::endl
+		<< "namespace vku {" << std::endl;
+
+	for (size_t i = 0; i < variants.size(); i++) {
+		file << "\t// " << variants[i].name << std::endl
+			<< "\tstatic const uint32_t shader" << i << "[] = {";
+		for (size_t word = 0; word < spirv[i].size(); word++) {
+			if (word % 8 == 0) {
+				file << std::endl << "\t\t";
+			}
+			file << "0x" << std::hex << std::setw(8) << std::setfill('0') << spirv[i][word] << std::dec << ",";
+		}
+		file << std::endl << "\t};" << std::endl;
+	}
+
+	if (variants.empty()) {
+		file << "\tconst EmbeddedShader* const embeddedShaders = nullptr;" << std::endl;
+	}
+	else {
+		file << std::endl << "\tstatic const EmbeddedShader table[] = {" << std::endl;
+		for (size_t i = 0; i < variants.size(); i++) {
+			file << "\t\t{ " << variants[i].getHashcode() << "ull, shader" << i << ", " << spirv[i].size() << " }," << std::endl;
+		}
+		file << "\t};" << std::endl
+			<< "\tconst EmbeddedShader* const embeddedShaders = table;" << std::endl;
+	}
+	file << "\tconst size_t embeddedShaderCount = " << variants.size() << ";" << std::endl
+		<< "}" << std::endl;
+
+	return file.good();
+}
+
+// answers one request per line until stdin closes. nothing else may go to stdout.
+static int runWorker() {
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		json response;
+		std::string errorMessage;
+		try {
+			json request = json::parse(line);
+			std::map<std::string, std::string> macros = request["macros"].get<std::map<std::string, std::string>>();
+			writeSpirv(request["spv"].get<std::string>(), compileShader(request["source"].get<std::string>(), macros, &errorMessage));
+			response["ok"] = true;
+		}
+		catch (const std::exception& e) {
+			response["ok"] = false;
+			response["error"] = errorMessage.empty() ? std::string(e.what()) : std::string(e.what()) + "\n" + errorMessage;
+		}
+		std::cout << response.dump() << std::endl;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	std::string shaderDirectory = "res/shaders/";
+	unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+	std::string embedPath;
+	std::vector<std::string> manifests;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool takesValue = arg == "-s" || arg == "--shaders" || arg == "-j" || arg == "--jobs" || arg == "--embed";
+		if (takesValue && i + 1 >= argc) {
+			std::cerr << "Missing value for " << arg << "." << std::endl;
+			printUsage();
+			return 1;
+		}
+
+		if (arg == "-s" || arg == "--shaders") {
+			shaderDirectory = argv[++i];
+		}
+		else if (arg == "-j" || arg == "--jobs") {
+			const char* value = argv[++i];
+			char* end = nullptr;
+			long parsed = std::strtol(value, &end, 10);
+			if (end == value || *end != '\0' || parsed < 1) {
+				std::cerr << "Invalid job count '" << value << "'." << std::endl;
+				printUsage();
+				return 1;
+			}
+			jobs = static_cast<unsigned>(std::min(parsed, 1024l));
+		}
+		else if (arg == "--embed") {
+			embedPath = argv[++i];
+		}
+		else if (arg == "--worker") {
+			return runWorker();
+		}
+		else if (arg == "-h" || arg == "--help") {
+			printUsage();
+			return 0;
+		}
+		else {
+			manifests.push_back(arg);
+		}
+	}
+	if (manifests.empty()) {
+		printUsage();
+		return 1;
+	}
+	if (shaderDirectory.back() != '/' && shaderDirectory.back() != '\\') {
+		shaderDirectory += "/";
+	}
+
+	// collect variants from all manifests, dropping duplicates
+	std::map<size_t, ShaderVariant> unique;
+	for (const std::string& manifest : manifests) {
+		try {
+			for (const ShaderVariant& variant : readShaderManifest(manifest)) {
+				unique[variant.getHashcode()] = variant;
+			}
+		}
+		catch (const std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+	std::vector<ShaderVariant> variants;
+	for (auto& [hash, variant] : unique) {
+		variants.push_back(variant);
+	}
+
+	// only kept in memory when embedding
+	std::vector<std::vector<uint32_t>> spirv(variants.size());
+
+	std::atomic<size_t> next(0);
+	std::atomic<size_t> failures(0);
+	std::mutex outputMutex;
+
+	auto worker = [&]() {
+		while (true) {
+			size_t i = next.fetch_add(1);
+			if (i >= variants.size()) {
+				break;
+			}
+			const ShaderVariant& variant = variants[i];
+			std::string sourcePath = shaderDirectory + variant.name;
+			std::string spvPath = variant.getSpirvPath(shaderDirectory);
+
+			std::string errorMessage;
+			try {
+				if (embedPath.empty()) {
+					writeSpirv(spvPath, compileShader(sourcePath, variant.macros, &errorMessage));
+				}
+				else {
+					spirv[i] = compileShader(sourcePath, variant.macros, &errorMessage);
+				}
+
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cout << "Baked '" << (embedPath.empty() ? spvPath : sourcePath) << "'" << std::endl;
+			}
+			catch (const std::runtime_error& e) {
+				failures++;
+
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cerr << e.what() << std::endl;
+				if (!errorMessage.empty()) {
+					std::cerr << errorMessage << std::endl;
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < std::min<size_t>(jobs, variants.size()); i++) {
+		threads.emplace_back(worker);
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	std::cout << "Baked " << (variants.size() - failures) << " of " << variants.size() << " shader variants." << std::endl;
+	if (failures > 0) {
+		return 1;
+	}
+
+	// the unique map already sorted the variants by hash
+	if (!embedPath.empty() && !writeEmbeddedShaders(embedPath, variants, spirv)) {
+		return 1;
+	}
+	return 0;
+}